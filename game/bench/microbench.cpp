@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <raylib.h>
+#include <nlohmann/json.hpp>
+#include "../engine/utils.hpp"
+#include "../engine/gfx.hpp"
+#include "../engine/sequence.hpp"
+#include "../engine/world.hpp"
+
+// Engine hot / load path microbenchmarks.
+//
+//   GardenDefenderMicrobench [--scale N] [--filter TEXT] [--samples N]
+//                            [--output FILE] [--baseline FILE] [--threshold PCT]
+//
+// Results are written as JSON. With --baseline the run is compared against a
+// previous output file and the exit code is 1 when any case got slower by more
+// than the threshold (default 10%).
+
+#define BENCH_DIR "bench/"
+
+struct BenchResult
+{
+	std::string name;
+	int size;
+	long long iterations;
+	double medianNs;
+	double minNs;
+};
+
+struct BenchOptions
+{
+	int scale = 1;
+	int samples = 7;
+	double sampleMs = 20;
+	std::string filter;
+	std::string output = "microbench.json";
+	std::string baseline;
+	double threshold = 10;
+};
+
+static BenchOptions options;
+static std::vector<BenchResult> results;
+static volatile long long sink = 0;
+
+// Keeps results alive so the optimizer can't drop the measured work
+static void consume(long long value)
+{
+	sink = sink + value;
+}
+
+// Runs fn enough times per sample to fill options.sampleMs, reports ns per call
+static void bench(std::string name, int size, std::function<void()> fn)
+{
+	if (!options.filter.empty() && name.find(options.filter) == std::string::npos) return;
+
+	using Clock = std::chrono::steady_clock;
+
+	long long iterations = 1;
+	while (true) {
+		auto start = Clock::now();
+		for (long long i = 0; i < iterations; i++) fn();
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		if (elapsed >= options.sampleMs || iterations >= (1LL << 30)) break;
+		iterations = elapsed <= 0 ? iterations * 10
+			: std::max(iterations + 1, (long long)(iterations * options.sampleMs / elapsed));
+	}
+
+	std::vector<double> samples;
+	for (int s = 0; s < options.samples; s++) {
+		auto start = Clock::now();
+		for (long long i = 0; i < iterations; i++) fn();
+		samples.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count() / iterations);
+	}
+
+	std::sort(samples.begin(), samples.end());
+	BenchResult result = { name, size, iterations, samples[samples.size() / 2], samples[0] };
+	results.push_back(result);
+
+	std::printf("%-32s size=%-7d %14.1f ns/op  (min %.1f, %lld iters)\n",
+		name.c_str(), size, result.medianNs, result.minNs, iterations);
+}
+
+// Synthetic inputs
+static void writeTexture(std::string path, int width, int height)
+{
+	Image image = GenImageColor(width, height, WHITE);
+	ExportImage(image, (ASSETS_ROOT + path).c_str());
+	UnloadImage(image);
+}
+
+static void writeJson(std::string path, const nlohmann::ordered_json& data)
+{
+	std::ofstream file(path);
+	file << data.dump();
+}
+
+static std::string writeTileset(int tileCount)
+{
+	int columns = 16;
+	int rows = (tileCount + columns - 1) / columns;
+	// Textures are cached by path, so every size gets its own file
+	std::string texture = BENCH_DIR "tiles_" + std::to_string(tileCount) + ".png";
+	writeTexture(texture, columns * 16, rows * 16);
+
+	nlohmann::ordered_json tileset;
+	tileset["name"] = "bench";
+	tileset["texture"] = texture;
+	tileset["cellSize"] = 16;
+
+	for (int id = 1; id <= tileCount; id++) {
+		nlohmann::ordered_json tile;
+		tile["solid"] = id % 3 == 0;
+		if (id % 8 == 0) {
+			tile["delay"] = 0.2f;
+			tile["frames"] = { id, std::max(id - 1, 1) };
+		}
+		tileset["tileDatas"][std::to_string(id)] = tile;
+	}
+
+	std::string path = ASSETS_ROOT BENCH_DIR "tileset_" + std::to_string(tileCount) + ".json";
+	writeJson(path, tileset);
+	return path;
+}
+
+static std::string writeOrdinarAnimation(int frameCount)
+{
+	std::string texture = "ordinar_" + std::to_string(frameCount) + ".png";
+	writeTexture(BENCH_DIR + texture, 16 * 32, 16 * ((frameCount + 31) / 32));
+
+	nlohmann::ordered_json animation;
+	animation["texture"] = texture;
+	animation["width"] = 16;
+	animation["height"] = 16;
+
+	for (int a = 0; a < 8; a++) {
+		nlohmann::ordered_json frames = nlohmann::ordered_json::array();
+		for (int f = 0; f < frameCount / 8; f++) {
+			frames.push_back({ { "index", a * (frameCount / 8) + f }, { "delay", 0.1f } });
+		}
+		animation["animations"]["anim" + std::to_string(a)] = frames;
+	}
+
+	std::string path = ASSETS_ROOT BENCH_DIR "ordinar_" + std::to_string(frameCount) + ".json";
+	writeJson(path, animation);
+	return path;
+}
+
+static std::string writeAsepriteAnimation(int frameCount)
+{
+	std::string texture = "aseprite_" + std::to_string(frameCount) + ".png";
+	writeTexture(BENCH_DIR + texture, 16 * 32, 16 * ((frameCount + 31) / 32));
+
+	nlohmann::ordered_json animation;
+	for (int f = 0; f < frameCount; f++) {
+		animation["frames"]["aseprite " + std::to_string(f) + ".aseprite"] = {
+			{ "frame", { { "x", f % 32 * 16 }, { "y", f / 32 * 16 }, { "w", 16 }, { "h", 16 } } },
+			{ "duration", 100 }
+		};
+	}
+
+	animation["meta"]["image"] = texture;
+	animation["meta"]["frameTags"] = nlohmann::ordered_json::array();
+	for (int a = 0; a < 8; a++) {
+		animation["meta"]["frameTags"].push_back({
+			{ "name", "tag" + std::to_string(a) },
+			{ "from", a * (frameCount / 8) },
+			{ "to", (a + 1) * (frameCount / 8) - 1 }
+		});
+	}
+
+	std::string path = ASSETS_ROOT BENCH_DIR "aseprite_" + std::to_string(frameCount) + ".json";
+	writeJson(path, animation);
+	return path;
+}
+
+static void fillLayer(TilemapLayer* layer, int tileCount, unsigned seed)
+{
+	std::mt19937 random(seed);
+	for (int i = 0; i < layer->getHeight(); i++) {
+		for (int j = 0; j < layer->getWidth(); j++) {
+			layer->setTile(random() % (tileCount + 1), i, j);
+		}
+	}
+}
+
+// Cases
+static void benchAtlas()
+{
+	for (int size : { 16 * options.scale, 64 * options.scale }) {
+		bench("atlas.createGrid", size * size, [size]() {
+			TextureAtlas atlas(size * 16, size * 16, 16, 16);
+			atlas.createGrid();
+			consume(atlas.getRegions().size());
+		});
+	}
+}
+
+static void benchLayer(Tileset* tileset)
+{
+	int tileCount = tileset->getTileCount();
+
+	for (int size : { 64 * options.scale, 256 * options.scale }) {
+		TilemapLayer layer("bench", tileset, size, size, 16);
+		fillLayer(&layer, tileCount, 1);
+
+		bench("layer.resize", size * size, [&layer, size]() {
+			layer.setWidth(size + size / 2);
+			layer.setHeight(size + size / 2);
+			layer.setWidth(size);
+			layer.setHeight(size);
+		});
+
+		bench("layer.setTile", size * size, [&layer, size]() {
+			for (int i = 0; i < size; i++) {
+				for (int j = 0; j < size; j++) {
+					layer.setTile((i + j) & 15, i, j);
+				}
+			}
+		});
+
+		bench("layer.getTile", size * size, [&layer, size]() {
+			long long sum = 0;
+			for (int i = 0; i < size; i++) {
+				for (int j = 0; j < size; j++) {
+					sum += layer.getTile(i, j);
+				}
+			}
+			consume(sum);
+		});
+	}
+}
+
+static void benchNavigation(Tileset* tileset)
+{
+	for (int size : { 64 * options.scale, 256 * options.scale }) {
+		Map map("bench", size, size, 16);
+		for (int l = 0; l < 3; l++) {
+			map.addMapLayer("layer" + std::to_string(l), tileset);
+			fillLayer(map.getMapLayer(l), tileset->getTileCount(), l + 1);
+		}
+
+		bench("map.generateNavigationMap", size * size, [&map]() {
+			map.generateNavigationMap();
+			consume(map.getNavigationMap()[0]);
+		});
+	}
+}
+
+static void benchTileset()
+{
+	for (int tiles : { 64 * options.scale, 1024 * options.scale }) {
+		std::string path = writeTileset(tiles);
+
+		bench("tileset.fromFile", tiles, [&path]() {
+			Tileset* tileset = Tileset::fromFile(path);
+			consume(tileset->getTileCount());
+			delete tileset;
+		});
+
+		Tileset* tileset = Tileset::fromFile(path);
+		bench("tileset.generateTiles", tiles, [tileset]() {
+			tileset->generateTiles();
+			consume(tileset->getTileCount());
+		});
+		delete tileset;
+	}
+}
+
+static void benchAnimation()
+{
+	for (int frames : { 32 * options.scale, 512 * options.scale }) {
+		std::string ordinar = writeOrdinarAnimation(frames);
+		std::string aseprite = writeAsepriteAnimation(frames);
+
+		bench("animation.load.ordinar", frames, [&ordinar]() {
+			AnimationPlayer player(ordinar);
+			consume(player.getAnimations().size());
+		});
+
+		bench("animation.load.aseprite", frames, [&aseprite]() {
+			AnimationPlayer player(aseprite);
+			consume(player.getAnimations().size());
+		});
+	}
+
+	std::string path = writeOrdinarAnimation(64);
+	for (int count : { 100 * options.scale, 10000 * options.scale }) {
+		std::vector<std::unique_ptr<AnimationPlayer>> players;
+		for (int i = 0; i < count; i++) {
+			players.push_back(std::make_unique<AnimationPlayer>(path));
+			players.back()->play("anim" + std::to_string(i % 8), true);
+		}
+
+		bench("animation.update", count, [&players]() {
+			for (auto& player : players) player->update(1.0f / 60.0f);
+		});
+	}
+}
+
+// Baseline comparison
+static int compareBaseline()
+{
+	std::ifstream file(options.baseline);
+	if (!file) {
+		std::printf("Baseline %s not found\n", options.baseline.c_str());
+		return 1;
+	}
+
+	nlohmann::json baseline = nlohmann::json::parse(file);
+	int regressions = 0;
+
+	std::printf("\nComparison against %s (threshold %.1f%%)\n", options.baseline.c_str(), options.threshold);
+	for (const BenchResult& result : results) {
+		for (auto& item : baseline["benchmarks"]) {
+			if (item["name"] != result.name || item["size"] != result.size) continue;
+
+			double before = item["median_ns"];
+			double change = (result.medianNs / before - 1.0) * 100.0;
+			bool regressed = change > options.threshold;
+			if (regressed) regressions++;
+
+			std::printf("%-32s size=%-7d %+8.1f%% %s\n", result.name.c_str(), result.size, change, regressed ? "REGRESSION" : "");
+		}
+	}
+
+	std::printf("%d regression(s)\n", regressions);
+	return regressions > 0 ? 1 : 0;
+}
+
+static void writeResults()
+{
+	nlohmann::ordered_json output;
+	output["scale"] = options.scale;
+	output["benchmarks"] = nlohmann::ordered_json::array();
+
+	for (const BenchResult& result : results) {
+		output["benchmarks"].push_back({
+			{ "name", result.name },
+			{ "size", result.size },
+			{ "iterations", result.iterations },
+			{ "median_ns", result.medianNs },
+			{ "min_ns", result.minNs }
+		});
+	}
+
+	std::ofstream file(options.output);
+	file << output.dump(2) << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (arg == "--scale" && hasValue) options.scale = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--samples" && hasValue) options.samples = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+		else if (arg == "--output" && hasValue) options.output = argv[++i];
+		else if (arg == "--baseline" && hasValue) options.baseline = argv[++i];
+		else if (arg == "--threshold" && hasValue) options.threshold = std::atof(argv[++i]);
+		else {
+			std::printf("Unknown argument %s\n", arg.c_str());
+			return 2;
+		}
+	}
+
+	// Texture loading needs a GL context
+	SetTraceLogLevel(LOG_WARNING);
+	SetConfigFlags(FLAG_WINDOW_HIDDEN);
+	InitWindow(64, 64, "microbench");
+
+	std::filesystem::create_directories(ASSETS_ROOT BENCH_DIR);
+
+	benchAtlas();
+
+	Tileset* tileset = Tileset::fromFile(writeTileset(64));
+	benchLayer(tileset);
+	benchNavigation(tileset);
+	delete tileset;
+
+	benchTileset();
+	benchAnimation();
+
+	writeResults();
+	std::printf("\nResults written to %s\n", options.output.c_str());
+
+	int status = options.baseline.empty() ? 0 : compareBaseline();
+
+	AssetManager::unloadTextures();
+	CloseWindow();
+	return status;
+}
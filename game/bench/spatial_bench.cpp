@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "../engine/spatial.hpp"
+
+// 200 towers targeting 10k moving enemies, grid vs brute force
+int main(int argc, char** argv)
+{
+	int towerCount = argc > 1 ? std::atoi(argv[1]) : 200;
+	int enemyCount = argc > 2 ? std::atoi(argv[2]) : 10000;
+	int ticks = argc > 3 ? std::atoi(argv[3]) : 100;
+
+	const int mapSize = 256;
+	const int cellSize = 16;
+	const float range = 5.0f * cellSize;
+	const float worldSize = (float)(mapSize * cellSize);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(0, worldSize);
+	std::uniform_real_distribution<float> step(-2.0f, 2.0f);
+
+	std::vector<Vector2> towers(towerCount);
+	for (Vector2& tower : towers) tower = { position(random), position(random) };
+
+	std::vector<Vector2> enemies(enemyCount);
+	for (Vector2& enemy : enemies) enemy = { position(random), position(random) };
+
+	SpatialGrid grid(mapSize, mapSize, cellSize);
+	std::vector<int> ids(enemyCount);
+	for (int i = 0; i < enemyCount; i++) ids[i] = grid.insert(enemies[i]);
+
+	using Clock = std::chrono::steady_clock;
+	double moveTime = 0, radiusTime = 0, nearestTime = 0, firstTime = 0, bruteTime = 0;
+	long long gridHits = 0, bruteHits = 0;
+	std::vector<int> found;
+
+	for (int tick = 0; tick < ticks; tick++) {
+		auto start = Clock::now();
+		for (int i = 0; i < enemyCount; i++) {
+			enemies[i].x = std::clamp(enemies[i].x + step(random), 0.0f, worldSize);
+			enemies[i].y = std::clamp(enemies[i].y + step(random), 0.0f, worldSize);
+			grid.move(ids[i], enemies[i]);
+			grid.setOrderKey(ids[i], (float)tick + i);
+		}
+		moveTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		for (Vector2 tower : towers) {
+			found.clear();
+			grid.queryRadius(tower, range, found);
+			gridHits += found.size();
+		}
+		radiusTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		for (Vector2 tower : towers) {
+			found.clear();
+			grid.queryNearest(tower, 3, range, found);
+		}
+		nearestTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		for (Vector2 tower : towers) grid.queryFirst(tower, range);
+		firstTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		start = Clock::now();
+		for (Vector2 tower : towers) {
+			for (Vector2 enemy : enemies) {
+				float dx = enemy.x - tower.x;
+				float dy = enemy.y - tower.y;
+				if (dx * dx + dy * dy <= range * range) bruteHits++;
+			}
+		}
+		bruteTime += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	std::printf("towers=%d enemies=%d ticks=%d\n", towerCount, enemyCount, ticks);
+	std::printf("move_ms_per_tick=%.4f\n", moveTime / ticks);
+	std::printf("radius_ms_per_tick=%.4f\n", radiusTime / ticks);
+	std::printf("nearest3_ms_per_tick=%.4f\n", nearestTime / ticks);
+	std::printf("first_ms_per_tick=%.4f\n", firstTime / ticks);
+	std::printf("brute_radius_ms_per_tick=%.4f\n", bruteTime / ticks);
+	std::printf("hits_match=%s\n", gridHits == bruteHits ? "yes" : "no");
+
+	return gridHits == bruteHits ? 0 : 1;
+}
@@ -0,0 +1,354 @@
+#include "audio.hpp"
+#include "utils.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+// Sound bank
+std::map<std::string, SoundId> SoundBank::soundIds;
+std::vector<std::unique_ptr<SoundData>> SoundBank::sounds;
+
+SoundId SoundBank::load(std::string path, int maxVoices, float volume)
+{
+	if (soundIds.contains(path)) {
+		return soundIds[path];
+	}
+
+	Wave wave = LoadWave((ASSETS_ROOT + path).c_str());
+	if (wave.frameCount == 0 || wave.data == nullptr) {
+		TraceLog(LOG_WARNING, ("AUDIO: Failed to load sound " + path).c_str());
+		return INVALID_SOUND;
+	}
+
+	WaveFormat(&wave, MIXER_SAMPLE_RATE, 32, MIXER_CHANNELS);
+
+	std::unique_ptr<SoundData> sound = std::make_unique<SoundData>();
+	sound->path = path;
+	sound->frameCount = wave.frameCount;
+	sound->maxVoices = maxVoices;
+	sound->volume = volume;
+
+	float* samples = LoadWaveSamples(wave);
+	sound->samples.assign(samples, samples + wave.frameCount * MIXER_CHANNELS);
+	UnloadWaveSamples(samples);
+	UnloadWave(wave);
+
+	SoundId id = sounds.size();
+	sounds.push_back(std::move(sound));
+	soundIds[path] = id;
+	return id;
+}
+
+void SoundBank::preload(const std::vector<std::string>& paths)
+{
+	for (const std::string& path : paths) {
+		load(path);
+	}
+}
+
+SoundId SoundBank::find(std::string path)
+{
+	auto it = soundIds.find(path);
+	return it != soundIds.end() ? it->second : INVALID_SOUND;
+}
+
+void SoundBank::unloadSounds()
+{
+	soundIds.clear();
+	sounds.clear();
+}
+
+// Backends
+SoundMixer* RaylibAudioBackend::activeMixer = nullptr;
+
+void RaylibAudioBackend::streamCallback(void* buffer, unsigned int frames)
+{
+	if (activeMixer) activeMixer->mix((float*)buffer, frames);
+	else std::memset(buffer, 0, frames * MIXER_CHANNELS * sizeof(float));
+}
+
+void RaylibAudioBackend::start(SoundMixer* mixer)
+{
+	if (!IsAudioDeviceReady()) {
+		InitAudioDevice();
+		ownsDevice = true;
+	}
+
+	activeMixer = mixer;
+
+	SetAudioStreamBufferSizeDefault(1024);
+	stream = LoadAudioStream(MIXER_SAMPLE_RATE, 32, MIXER_CHANNELS);
+	SetAudioStreamCallback(stream, streamCallback);
+	PlayAudioStream(stream);
+}
+
+void RaylibAudioBackend::stop()
+{
+	if (stream.buffer == nullptr) return;
+
+	StopAudioStream(stream);
+	UnloadAudioStream(stream);
+	stream = { 0 };
+	activeMixer = nullptr;
+
+	if (ownsDevice) {
+		CloseAudioDevice();
+		ownsDevice = false;
+	}
+}
+
+void NullAudioBackend::start(SoundMixer* mixer)
+{
+	this->mixer = mixer;
+	if (!threaded || running) return;
+
+	running = true;
+	worker = std::thread([this]() {
+		// Roughly real time, 10 ms per block
+		while (running) {
+			pull(MIXER_SAMPLE_RATE / 100);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	});
+}
+
+void NullAudioBackend::stop()
+{
+	running = false;
+	if (worker.joinable()) worker.join();
+	mixer = nullptr;
+}
+
+float NullAudioBackend::pull(int frames)
+{
+	if (!mixer) return 0;
+
+	buffer.resize(frames * MIXER_CHANNELS);
+	mixer->mix(buffer.data(), frames);
+
+	float peak = 0;
+	for (float sample : buffer) peak = std::max(peak, std::abs(sample));
+	return peak;
+}
+
+// Mixer
+SoundMixer::SoundMixer(AudioBackend* backend)
+{
+	this->backend = backend;
+	for (int i = 0; i < MIXER_MAX_VOICES; i++) finishedGenerations[i] = 0;
+
+	backend->start(this);
+}
+
+SoundMixer::~SoundMixer()
+{
+	backend->stop();
+}
+
+void SoundMixer::play(SoundId id, Vector2 position)
+{
+	requests.push_back({ id, position, true, 0 });
+}
+
+void SoundMixer::play(SoundId id)
+{
+	requests.push_back({ id, { 0, 0 }, false, 0 });
+}
+
+void SoundMixer::stopAll()
+{
+	requests.clear();
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	for (int i = 0; i < MIXER_MAX_VOICES; i++) {
+		if (slots[i].id == INVALID_SOUND) continue;
+
+		pendingCommands.push_back({ VOICE_STOP, i, slots[i].generation, nullptr, 0, 0 });
+		slots[i].id = INVALID_SOUND;
+	}
+}
+
+void SoundMixer::computeGains(const Request& request, const SoundData* sound, float& left, float& right)
+{
+	float gain = sound->volume * masterVolume;
+	float pan = 0;
+
+	if (request.positional) {
+		float falloff = (request.distance - minDistance) / std::max(maxDistance - minDistance, 1.0f);
+		gain *= 1.0f - std::clamp(falloff, 0.0f, 1.0f);
+		pan = std::clamp((request.position.x - lastListener.x) / maxDistance, -1.0f, 1.0f);
+	}
+
+	left = gain * std::min(1.0f, 1.0f - pan);
+	right = gain * std::min(1.0f, 1.0f + pan);
+}
+
+void SoundMixer::startVoice(int slot, const Request& request)
+{
+	const SoundData* sound = SoundBank::get(request.id);
+
+	VoiceSlot& voiceSlot = slots[slot];
+	voiceSlot.id = request.id;
+	voiceSlot.position = request.position;
+	voiceSlot.positional = request.positional;
+	voiceSlot.distance = request.distance;
+	voiceSlot.generation++;
+
+	float left, right;
+	computeGains(request, sound, left, right);
+	newCommands.push_back({ VOICE_START, slot, voiceSlot.generation, sound, left, right });
+	stats.played++;
+}
+
+void SoundMixer::update(Vector2 listener)
+{
+	lastListener = listener;
+	newCommands.clear();
+
+	std::vector<int> activeCounts(SoundBank::getCount(), 0);
+	stats.activeVoices = 0;
+
+	// Retire finished voices and re-pan the ones still playing
+	for (int i = 0; i < MIXER_MAX_VOICES; i++) {
+		VoiceSlot& slot = slots[i];
+		if (!isSlotBusy(i)) {
+			slot.id = INVALID_SOUND;
+			continue;
+		}
+
+		activeCounts[slot.id]++;
+		stats.activeVoices++;
+
+		if (!slot.positional) continue;
+
+		Request current = { slot.id, slot.position, true, 0 };
+		current.distance = std::hypot(slot.position.x - listener.x, slot.position.y - listener.y);
+		slot.distance = current.distance;
+
+		float left, right;
+		computeGains(current, SoundBank::get(slot.id), left, right);
+		newCommands.push_back({ VOICE_GAIN, i, slot.generation, nullptr, left, right });
+	}
+
+	for (Request& request : requests) {
+		request.distance = request.positional
+			? std::hypot(request.position.x - listener.x, request.position.y - listener.y)
+			: 0;
+	}
+
+	// Nearest requests get voices first
+	std::stable_sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+		return a.distance < b.distance;
+	});
+
+	for (const Request& request : requests) {
+		const SoundData* sound = SoundBank::get(request.id);
+		if (sound == nullptr || (request.positional && request.distance > maxDistance)) {
+			stats.culled++;
+			continue;
+		}
+
+		int target = -1;
+		bool limited = activeCounts[request.id] >= sound->maxVoices;
+
+		if (!limited) {
+			for (int i = 0; i < MIXER_MAX_VOICES; i++) {
+				if (slots[i].id == INVALID_SOUND) {
+					target = i;
+					break;
+				}
+			}
+		}
+
+		// Steal the farthest voice, of the same sound when that sound is at its limit
+		if (target == -1) {
+			for (int i = 0; i < MIXER_MAX_VOICES; i++) {
+				if (slots[i].id == INVALID_SOUND) continue;
+				if (limited && slots[i].id != request.id) continue;
+				if (slots[i].distance <= request.distance) continue;
+				if (target == -1 || slots[i].distance > slots[target].distance) target = i;
+			}
+
+			if (target == -1) {
+				stats.culled++;
+				continue;
+			}
+
+			activeCounts[slots[target].id]--;
+			stats.stolen++;
+		}
+		else {
+			stats.activeVoices++;
+		}
+
+		startVoice(target, request);
+		activeCounts[request.id]++;
+	}
+
+	requests.clear();
+
+	if (newCommands.empty()) return;
+
+	std::lock_guard<std::mutex> lock(commandMutex);
+	pendingCommands.insert(pendingCommands.end(), newCommands.begin(), newCommands.end());
+}
+
+void SoundMixer::mix(float* output, int frames)
+{
+	{
+		std::lock_guard<std::mutex> lock(commandMutex);
+		mixerCommands.swap(pendingCommands);
+	}
+
+	for (const Command& command : mixerCommands) {
+		Voice& voice = voices[command.voice];
+
+		switch (command.type)
+		{
+		case VOICE_START:
+			voice.sound = command.sound;
+			voice.generation = command.generation;
+			voice.cursor = 0;
+			voice.left = command.left;
+			voice.right = command.right;
+			break;
+		case VOICE_STOP:
+			if (voice.generation != command.generation) break;
+			voice.sound = nullptr;
+			finishedGenerations[command.voice] = command.generation;
+			break;
+		case VOICE_GAIN:
+			if (voice.generation != command.generation) break;
+			voice.left = command.left;
+			voice.right = command.right;
+			break;
+		}
+	}
+	mixerCommands.clear();
+
+	std::memset(output, 0, frames * MIXER_CHANNELS * sizeof(float));
+
+	for (int v = 0; v < MIXER_MAX_VOICES; v++) {
+		Voice& voice = voices[v];
+		if (voice.sound == nullptr) continue;
+
+		int count = std::min(frames, voice.sound->frameCount - voice.cursor);
+		const float* samples = voice.sound->samples.data() + voice.cursor * MIXER_CHANNELS;
+
+		for (int i = 0; i < count; i++) {
+			output[i * 2] += samples[i * 2] * voice.left;
+			output[i * 2 + 1] += samples[i * 2 + 1] * voice.right;
+		}
+
+		voice.cursor += count;
+		if (voice.cursor >= voice.sound->frameCount) {
+			voice.sound = nullptr;
+			finishedGenerations[v] = voice.generation;
+		}
+	}
+
+	for (int i = 0; i < frames * MIXER_CHANNELS; i++) {
+		output[i] = std::clamp(output[i], -1.0f, 1.0f);
+	}
+}
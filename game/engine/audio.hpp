@@ -0,0 +1,208 @@
+#pragma once
+#include <raylib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+
+#define MIXER_SAMPLE_RATE 44100
+#define MIXER_CHANNELS 2
+#define MIXER_MAX_VOICES 32
+
+typedef int SoundId;
+#define INVALID_SOUND -1
+
+// Decoded sample data, always float stereo at MIXER_SAMPLE_RATE
+struct SoundData
+{
+	std::string path;
+	std::vector<float> samples;
+	int frameCount = 0;
+
+	int maxVoices = 4;
+	float volume = 1.0f;
+};
+
+// Sounds are preloaded once and referenced by id afterwards.
+// Loading the same path twice returns the same id.
+class SoundBank
+{
+private:
+	static std::map<std::string, SoundId> soundIds;
+	static std::vector<std::unique_ptr<SoundData>> sounds;
+
+public:
+	static SoundId load(std::string path, int maxVoices = 4, float volume = 1.0f);
+	static void preload(const std::vector<std::string>& paths);
+
+	static SoundId find(std::string path);
+	static SoundData* get(SoundId id) { return id >= 0 && id < sounds.size() ? sounds[id].get() : nullptr; }
+	static int getCount() { return sounds.size(); }
+
+	// The mixer must be stopped before unloading
+	static void unloadSounds();
+};
+
+class SoundMixer;
+
+class AudioBackend
+{
+public:
+	virtual ~AudioBackend() {}
+
+	virtual void start(SoundMixer* mixer) = 0;
+	virtual void stop() = 0;
+};
+
+// Mixer output goes to a raylib audio stream, mixed on the audio thread
+class RaylibAudioBackend : public AudioBackend
+{
+public:
+	void start(SoundMixer* mixer) override;
+	void stop() override;
+
+private:
+	static SoundMixer* activeMixer;
+	static void streamCallback(void* buffer, unsigned int frames);
+
+	AudioStream stream = { 0 };
+	bool ownsDevice = false;
+};
+
+// Mixes into a scratch buffer on its own thread and throws the result away.
+// For headless runs and tests; threaded = false leaves pulling to the caller.
+class NullAudioBackend : public AudioBackend
+{
+public:
+	NullAudioBackend(bool threaded = true) : threaded(threaded) {}
+	~NullAudioBackend() { stop(); }
+
+	void start(SoundMixer* mixer) override;
+	void stop() override;
+
+	// Mixes the given number of frames right away, returns the peak sample
+	float pull(int frames);
+
+private:
+	SoundMixer* mixer = nullptr;
+	bool threaded;
+	std::atomic<bool> running = false;
+	std::thread worker;
+	std::vector<float> buffer;
+};
+
+struct SoundMixerStats
+{
+	int activeVoices = 0;
+	uint64_t played = 0;
+	uint64_t culled = 0;
+	uint64_t stolen = 0;
+};
+
+// Voice allocation happens on the main thread in update(); the audio thread
+// only executes the resulting start / stop / gain commands.
+class SoundMixer
+{
+public:
+	SoundMixer(AudioBackend* backend);
+	~SoundMixer();
+
+	inline float getMinDistance() const { return minDistance; }
+	inline float getMaxDistance() const { return maxDistance; }
+	inline void setDistances(float minDistance, float maxDistance) {
+		this->minDistance = minDistance;
+		this->maxDistance = maxDistance;
+	}
+
+	inline float getMasterVolume() const { return masterVolume; }
+	inline void setMasterVolume(float volume) { masterVolume = volume; }
+
+	inline SoundMixerStats getStats() const { return stats; }
+
+	// Positional request, resolved against the listener on the next update
+	void play(SoundId id, Vector2 position);
+	// Non-positional request (UI), always centered and at full volume
+	void play(SoundId id);
+	void stopAll();
+
+	void update(Vector2 listener);
+
+	// Called from the audio thread, adds into an interleaved stereo buffer
+	void mix(float* output, int frames);
+
+private:
+	enum CommandType
+	{
+		VOICE_START,
+		VOICE_STOP,
+		VOICE_GAIN
+	};
+
+	struct Command
+	{
+		CommandType type;
+		int voice;
+		uint32_t generation;
+		const SoundData* sound;
+		float left;
+		float right;
+	};
+
+	struct Request
+	{
+		SoundId id;
+		Vector2 position;
+		bool positional;
+		float distance;
+	};
+
+	// Main thread view of a voice
+	struct VoiceSlot
+	{
+		SoundId id = INVALID_SOUND;
+		Vector2 position;
+		bool positional = false;
+		float distance = 0;
+		uint32_t generation = 0;
+	};
+
+	// Audio thread view of a voice
+	struct Voice
+	{
+		const SoundData* sound = nullptr;
+		uint32_t generation = 0;
+		int cursor = 0;
+		float left = 0;
+		float right = 0;
+	};
+
+	AudioBackend* backend;
+
+	float minDistance = 64;
+	float maxDistance = 512;
+	float masterVolume = 1.0f;
+
+	Vector2 lastListener = { 0, 0 };
+	std::vector<Request> requests;
+	std::vector<Command> newCommands;
+	VoiceSlot slots[MIXER_MAX_VOICES];
+	SoundMixerStats stats;
+
+	std::mutex commandMutex;
+	std::vector<Command> pendingCommands;
+	std::vector<Command> mixerCommands;
+	Voice voices[MIXER_MAX_VOICES];
+	// Written by the audio thread when a voice runs out of samples
+	std::atomic<uint32_t> finishedGenerations[MIXER_MAX_VOICES];
+
+	inline bool isSlotBusy(int slot) const {
+		return slots[slot].id != INVALID_SOUND && finishedGenerations[slot].load() != slots[slot].generation;
+	}
+
+	void startVoice(int slot, const Request& request);
+	void computeGains(const Request& request, const SoundData* sound, float& left, float& right);
+};
@@ -1,4 +1,6 @@
 #include "core.hpp"
+#include <algorithm>
+#include <chrono>
 
 void Game::run()
 {
@@ -7,25 +9,195 @@ void Game::run()
     Texture2D gardenTilesetTex = AssetManager::loadTexture("GardenTS.png");
     atlas = new TextureAtlas(48, 32, 16, 16);
 
+    mixer = new SoundMixer(&audioBackend);
+    if (map && waveSchedule) {
+        spawner = new WaveSpawner(map, waveSchedule);
+        spawner->setMixer(mixer);
+        history.setSpriteSource(spawner);
+    }
+
+    running = true;
+    simulationThread = std::thread(&Game::simulate, this);
+
     while (!WindowShouldClose()) {
-        update();
-        draw();
+        pollInput();
+        draw(snapshots.read());
     }
 
+    running = false;
+    simulationThread.join();
+
+    delete pathfinder;
+    pathfinder = nullptr;
+    history.setSpriteSource(nullptr);
+    delete spawner;
+    spawner = nullptr;
+
+    delete mixer;
+    mixer = nullptr;
+    SoundBank::unloadSounds();
+
     AssetManager::unloadTextures();
     CloseWindow();
 }
 
-void Game::update()
+void Game::simulate()
+{
+    using Clock = std::chrono::steady_clock;
+
+    const float delta = 1.0f / tickRate;
+    const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(delta));
+
+    Clock::time_point nextTick = Clock::now();
+
+    while (running) {
+        if (hasPendingMap) {
+            std::lock_guard<std::mutex> lock(pendingMapMutex);
+            applyMap(pendingMap);
+            hasPendingMap = false;
+        }
+
+        InputEvent event;
+        while (inputEvents.pop(event)) {
+            handleInput(event);
+        }
+
+        update(delta);
+        tick++;
+
+        GameSnapshot& snapshot = history.record(map, camera, tick);
+        if (spawner) spawner->saveState(snapshot.userData);
+
+        snapshotBuilder.capture(map, camera, tick, snapshots.getWriteBuffer());
+        snapshots.publish();
+
+        // Don't try to catch up after a long stall, just drop the missed ticks
+        nextTick = std::max(nextTick + step, Clock::now() - step);
+        std::this_thread::sleep_until(nextTick);
+    }
+}
+
+void Game::setMap(Map* map)
 {
+    if (!running) {
+        applyMap(map);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pendingMapMutex);
+    pendingMap = map;
+    hasPendingMap = true;
 }
 
-void Game::draw()
+void Game::applyMap(Map* map)
+{
+    if (this->map == map) return;
+    this->map = map;
+
+    // The pathfinder is recreated for the new map on the next update
+    delete pathfinder;
+    pathfinder = nullptr;
+
+    if (spawner) spawner->setMap(map);
+    history.clear();
+}
+
+void Game::pollInput()
+{
+    int key = GetKeyPressed();
+    while (key != KEY_NULL) {
+        inputEvents.push({ INPUT_KEY_PRESSED, key, { 0, 0 } });
+        heldKeys.push_back(key);
+        key = GetKeyPressed();
+    }
+
+    for (int i = 0; i < heldKeys.size();) {
+        if (IsKeyReleased(heldKeys[i])) {
+            inputEvents.push({ INPUT_KEY_RELEASED, heldKeys[i], { 0, 0 } });
+            heldKeys.erase(heldKeys.begin() + i);
+        }
+        else i++;
+    }
+
+    Vector2 mouse = GetMousePosition();
+    const int buttons[] = { MOUSE_BUTTON_LEFT, MOUSE_BUTTON_RIGHT, MOUSE_BUTTON_MIDDLE };
+    for (int button : buttons) {
+        if (IsMouseButtonPressed(button)) inputEvents.push({ INPUT_MOUSE_PRESSED, button, mouse });
+        if (IsMouseButtonReleased(button)) inputEvents.push({ INPUT_MOUSE_RELEASED, button, mouse });
+    }
+}
+
+void Game::handleInput(const InputEvent& event)
+{
+    if (event.type != INPUT_KEY_PRESSED) return;
+
+    if (event.code == KEY_F5) quickSave();
+    else if (event.code == KEY_F9) quickLoad();
+}
+
+void Game::quickSave()
+{
+    const GameSnapshot* latest = history.getRecorded(0);
+    if (latest == nullptr) return;
+
+    SnapshotManager::serialize(*latest, quickSaveData);
+    TraceLog(LOG_INFO, ("GAME: Quick saved tick " + std::to_string(tick) + ", "
+        + std::to_string(quickSaveData.size()) + " bytes").c_str());
+}
+
+bool Game::quickLoad()
+{
+    GameSnapshot snapshot;
+    if (quickSaveData.empty() || !SnapshotManager::deserialize(quickSaveData, snapshot)) return false;
+
+    history.restore(map, snapshot, camera, tick);
+    history.clear();
+    if (pathfinder) pathfinder->rebuild();
+    if (spawner) {
+        spawner->loadState(snapshot.userData);
+        spawner->reconcile();
+    }
+    return true;
+}
+
+bool Game::rollback(int ticks)
+{
+    if (!history.rollback(map, ticks, camera, tick)) return false;
+
+    if (pathfinder) pathfinder->rebuild();
+    if (spawner) {
+        spawner->loadState(history.getRecorded(0)->userData);
+        spawner->reconcile();
+    }
+    return true;
+}
+
+void Game::update(float delta)
+{
+    if (map) {
+        map->update(delta);
+
+        if (pathfinder == nullptr) pathfinder = new HierarchicalPathfinder(map);
+        pathfinder->update(pathfindingBudgetMs);
+
+        if (spawner) spawner->update(delta);
+    }
+
+    // Listen from the world point at the center of the screen
+    mixer->update({
+        camera.target.x + (width / 2.0f - camera.offset.x) / camera.zoom,
+        camera.target.y + (height / 2.0f - camera.offset.y) / camera.zoom
+    });
+}
+
+void Game::draw(const RenderSnapshot& snapshot)
 {
     BeginDrawing();
 
     ClearBackground(RAYWHITE);
 
+    renderer.draw(snapshot, width, height);
+
     // DrawTextureRec(AssetManager::loadTexture("GardenTS.png"), atlas->getRegion(0), { 20, 20 }, WHITE);
 
     EndDrawing();
@@ -1,8 +1,41 @@
+#pragma once
 #include <raylib.h>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <vector>
 #include "utils.hpp"
 #include "gfx.hpp"
+#include "audio.hpp"
+#include "world.hpp"
+#include "render.hpp"
+#include "threading.hpp"
+#include "savestate.hpp"
+#include "pathfinding.hpp"
+#include "spawning.hpp"
 
+enum InputEventType
+{
+    INPUT_KEY_PRESSED,
+    INPUT_KEY_RELEASED,
+    INPUT_MOUSE_PRESSED,
+    INPUT_MOUSE_RELEASED
+};
+
+// Collected on the render thread, handled on the simulation thread
+struct InputEvent
+{
+    InputEventType type;
+    int code;
+    Vector2 position;
+};
+
+// The simulation runs at a fixed tick rate on its own thread and publishes a
+// RenderSnapshot after every tick. The main thread owns the window and the GL
+// context, so it only polls input and draws the latest snapshot.
+// Anything that loads textures must do so on the main thread, before run()
+// starts the simulation.
 class Game
 {
 protected:
@@ -11,6 +44,18 @@ protected:
     int height;
 
     TextureAtlas* atlas;
+
+    RaylibAudioBackend audioBackend;
+    SoundMixer* mixer = nullptr;
+
+    Map* map = nullptr;
+    HierarchicalPathfinder* pathfinder = nullptr;
+    double pathfindingBudgetMs = 1;
+    WaveSchedule* waveSchedule = nullptr;
+    WaveSpawner* spawner = nullptr;
+    Camera2D camera = { { 0, 0 }, { 0, 0 }, 0, 1 };
+    float tickRate = 60;
+    uint64_t tick = 0;
 public:
     Game(std::string title, int width, int height) : title(title), width(width), height(height) {}
 
@@ -19,7 +64,54 @@ public:
     int getWidth() const { return width; }
     int getHeight() const { return height; }
 
+    SoundMixer* getMixer() { return mixer; }
+
+    Map* getMap() { return map; }
+    // Once run() has started, the swap is applied by the simulation thread at its next tick
+    void setMap(Map* map);
+
+    // Created on the first tick with a map, simulation thread only
+    HierarchicalPathfinder* getPathfinder() { return pathfinder; }
+    double getPathfindingBudget() const { return pathfindingBudgetMs; }
+    void setPathfindingBudget(double budgetMs) { pathfindingBudgetMs = budgetMs; }
+
+    // Set before run(), the spawner is created there together with the other assets
+    WaveSchedule* getWaveSchedule() { return waveSchedule; }
+    void setWaveSchedule(WaveSchedule* waveSchedule) { this->waveSchedule = waveSchedule; }
+    WaveSpawner* getSpawner() { return spawner; }
+
+    float getTickRate() const { return tickRate; }
+    void setTickRate(float tickRate) { this->tickRate = tickRate; }
+
+    // Simulation thread only
+    void quickSave();
+    bool quickLoad();
+    bool rollback(int ticks);
+
     void run();
-    void update();
-    void draw();
+    void update(float delta);
+    void draw(const RenderSnapshot& snapshot);
+    void handleInput(const InputEvent& event);
+
+private:
+    std::atomic<bool> running = false;
+    std::thread simulationThread;
+
+    TripleBuffer<RenderSnapshot> snapshots;
+    SpscQueue<InputEvent, 256> inputEvents;
+    RenderSnapshotBuilder snapshotBuilder;
+    SnapshotRenderer renderer;
+
+    SnapshotManager history;
+    std::vector<uint8_t> quickSaveData;
+
+    std::vector<int> heldKeys;
+
+    std::mutex pendingMapMutex;
+    std::atomic<bool> hasPendingMap = false;
+    Map* pendingMap = nullptr;
+
+    void applyMap(Map* map);
+    void simulate();
+    void pollInput();
 };
@@ -0,0 +1,233 @@
+#include "editing.hpp"
+#include <algorithm>
+#include <cstring>
+
+TileEditor::TileEditor(Map* map, HierarchicalPathfinder* pathfinder, VisibilitySystem* visibility, size_t historyBudget)
+{
+	this->map = map;
+	this->pathfinder = pathfinder;
+	this->visibility = visibility;
+	this->historyBudget = historyBudget;
+}
+
+TilemapLayer* TileEditor::getLayer(int layer)
+{
+	if (layer < 0 || layer >= map->getMapLayers().size()) {
+		TraceLog(LOG_WARNING, ("EDITOR: Layer " + std::to_string(layer) + " does not exist").c_str());
+		return nullptr;
+	}
+
+	return map->getMapLayer(layer);
+}
+
+// Area an edit can change, one cell wider when autotiling may re-pick the neighbours
+static TileRect editArea(TilemapLayer* target, TileRect rect)
+{
+	rect = target->clipRect(rect);
+	if (rect.isEmpty() || target->getTileset() == nullptr || !target->getTileset()->hasAutotiles()) return rect;
+
+	return target->clipRect({ rect.row - 1, rect.col - 1, rect.width + 2, rect.height + 2 });
+}
+
+// Edits
+TileRect TileEditor::fillRect(int layer, int tileId, TileRect rect)
+{
+	TilemapLayer* target = getLayer(layer);
+	if (target == nullptr) return {};
+
+	TileRect area = editArea(target, rect);
+	TileRegion before = target->copyRegion(area);
+
+	TileRect written = target->fillRect(tileId, rect);
+	target->resolveAutotiles(area);
+	push(diff(layer, area, before));
+	return written;
+}
+
+TileRect TileEditor::floodFill(int layer, int tileId, int row, int col)
+{
+	TilemapLayer* target = getLayer(layer);
+	if (target == nullptr || row < 0 || col < 0 || row >= target->getHeight() || col >= target->getWidth()) return {};
+
+	int previous = target->getTile(row, col);
+
+	TileDelta delta;
+	delta.layer = layer;
+	TileRect written = target->floodFill(tileId, row, col, &delta.spans);
+	if (written.isEmpty()) return written;
+
+	if (target->getTileset() && target->getTileset()->hasAutotiles()) {
+		// Rebuild the area as it was from the filled runs, then let autotiling settle
+		TileRect area = editArea(target, written);
+		TileRegion before = target->copyRegion(area);
+		for (const TileSpan& span : delta.spans) {
+			std::fill_n(&before.tiles[(span.row - area.row) * area.width + span.col - area.col], span.length, previous);
+		}
+
+		target->resolveAutotiles(area);
+		push(diff(layer, area, before));
+		return written;
+	}
+
+	// The filled runs are the delta, all of them held the same tile before
+	int count = 0;
+	for (const TileSpan& span : delta.spans) count += span.length;
+	delta.before.assign(count, previous);
+	delta.after.assign(count, tileId);
+	delta.bounds = written;
+
+	push(std::move(delta));
+	return written;
+}
+
+TileRegion TileEditor::copy(int layer, TileRect rect)
+{
+	TilemapLayer* source = getLayer(layer);
+	return source ? source->copyRegion(rect) : TileRegion{};
+}
+
+TileRect TileEditor::paste(int layer, const TileRegion& region, int row, int col, bool skipEmpty)
+{
+	TilemapLayer* target = getLayer(layer);
+	if (target == nullptr) return {};
+
+	TileRect area = editArea(target, { row, col, region.width, region.height });
+	TileRegion before = target->copyRegion(area);
+
+	TileRect written = target->stamp(region, row, col, skipEmpty);
+	target->resolveAutotiles(area);
+	push(diff(layer, area, before));
+	return written;
+}
+
+TileRect TileEditor::blit(int sourceLayer, int layer, TileRect from, int row, int col)
+{
+	TilemapLayer* source = getLayer(sourceLayer);
+	TilemapLayer* target = getLayer(layer);
+	if (source == nullptr || target == nullptr) return {};
+
+	TileRect area = editArea(target, { row, col, from.width, from.height });
+	TileRegion before = target->copyRegion(area);
+
+	TileRect written = target->blit(*source, from, row, col);
+	target->resolveAutotiles(area);
+	push(diff(layer, area, before));
+	return written;
+}
+
+// History
+TileDelta TileEditor::diff(int layer, TileRect area, const TileRegion& before)
+{
+	TilemapLayer* target = map->getMapLayer(layer);
+	const int* layout = target->getLayout();
+	int width = target->getWidth();
+
+	TileDelta delta;
+	delta.layer = layer;
+
+	int top = area.row + area.height, left = area.col + area.width, bottom = -1, right = -1;
+
+	for (int i = 0; i < area.height; i++) {
+		const int* previous = &before.tiles[i * area.width];
+		const int* current = &layout[(area.row + i) * width + area.col];
+
+		for (int j = 0; j < area.width;) {
+			if (previous[j] == current[j]) {
+				j++;
+				continue;
+			}
+
+			int start = j;
+			while (j < area.width && previous[j] != current[j]) j++;
+
+			delta.spans.push_back({ area.row + i, area.col + start, j - start });
+			delta.before.insert(delta.before.end(), previous + start, previous + j);
+			delta.after.insert(delta.after.end(), current + start, current + j);
+
+			top = std::min(top, area.row + i);
+			bottom = area.row + i;
+			left = std::min(left, area.col + start);
+			right = std::max(right, area.col + j - 1);
+		}
+	}
+
+	if (!delta.spans.empty()) delta.bounds = { top, left, right - left + 1, bottom - top + 1 };
+	return delta;
+}
+
+void TileEditor::push(TileDelta&& delta)
+{
+	if (delta.spans.empty()) return;
+
+	notify(delta.bounds);
+
+	for (const TileDelta& item : redoStack) historySize -= item.getSize();
+	redoStack.clear();
+
+	historySize += delta.getSize();
+	undoStack.push_back(std::move(delta));
+	trimHistory();
+}
+
+void TileEditor::trimHistory()
+{
+	// The latest step is always kept, however large
+	while (historySize > historyBudget && undoStack.size() > 1) {
+		historySize -= undoStack.front().getSize();
+		undoStack.pop_front();
+	}
+}
+
+void TileEditor::apply(const TileDelta& delta, bool undo)
+{
+	// Layers removed or shrunk since the edit can't take it back
+	TilemapLayer* target = getLayer(delta.layer);
+	if (target == nullptr || target->clipRect(delta.bounds).width != delta.bounds.width
+		|| target->clipRect(delta.bounds).height != delta.bounds.height) return;
+
+	int* layout = target->getLayout();
+	int width = target->getWidth();
+
+	const int* tiles = undo ? delta.before.data() : delta.after.data();
+	for (const TileSpan& span : delta.spans) {
+		std::memcpy(&layout[span.row * width + span.col], tiles, span.length * sizeof(int));
+		tiles += span.length;
+	}
+
+	target->markRectDirty(delta.bounds);
+	notify(delta.bounds);
+}
+
+bool TileEditor::undo()
+{
+	if (undoStack.empty()) return false;
+
+	apply(undoStack.back(), true);
+	redoStack.push_back(std::move(undoStack.back()));
+	undoStack.pop_back();
+	return true;
+}
+
+bool TileEditor::redo()
+{
+	if (redoStack.empty()) return false;
+
+	apply(redoStack.back(), false);
+	undoStack.push_back(std::move(redoStack.back()));
+	redoStack.pop_back();
+	return true;
+}
+
+void TileEditor::clearHistory()
+{
+	undoStack.clear();
+	redoStack.clear();
+	historySize = 0;
+}
+
+void TileEditor::notify(TileRect rect)
+{
+	map->updateNavigationRect(rect);
+	if (pathfinder) pathfinder->notifyRegionChanged(rect);
+	if (visibility) visibility->notifyRegionChanged(rect);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include "world.hpp"
+#include "pathfinding.hpp"
+#include "visibility.hpp"
+
+// Cells changed by one edit, as runs. before and after hold the tiles of
+// every span back to back, in span order.
+struct TileDelta
+{
+	int layer;
+	TileRect bounds;
+	std::vector<TileSpan> spans;
+	std::vector<int> before;
+	std::vector<int> after;
+
+	inline size_t getSize() const {
+		return sizeof(TileDelta) + spans.size() * sizeof(TileSpan) + (before.size() + after.size()) * sizeof(int);
+	}
+};
+
+// Bulk edits on the layers of a map, for level tooling and build mode.
+// Every edit updates the navigation map, the pathfinder and the visibility
+// fields once for the written area and is recorded as a delta for undo and redo. On autotiled
+// layers the cells around the edit are re-resolved and recorded with it.
+class TileEditor
+{
+public:
+	TileEditor(Map* map, HierarchicalPathfinder* pathfinder = nullptr, VisibilitySystem* visibility = nullptr, size_t historyBudget = 8 * 1024 * 1024);
+
+	inline Map* getMap() { return map; }
+	inline void setPathfinder(HierarchicalPathfinder* pathfinder) { this->pathfinder = pathfinder; }
+	inline void setVisibility(VisibilitySystem* visibility) { this->visibility = visibility; }
+
+	TileRect fillRect(int layer, int tileId, TileRect rect);
+	TileRect eraseRect(int layer, TileRect rect) { return fillRect(layer, 0, rect); }
+	TileRect floodFill(int layer, int tileId, int row, int col);
+	TileRegion copy(int layer, TileRect rect);
+	TileRect paste(int layer, const TileRegion& region, int row, int col, bool skipEmpty = false);
+	TileRect blit(int sourceLayer, int layer, TileRect from, int row, int col);
+
+	inline bool canUndo() const { return !undoStack.empty(); }
+	inline bool canRedo() const { return !redoStack.empty(); }
+	bool undo();
+	bool redo();
+	void clearHistory();
+
+	// Bytes held by the undo and redo deltas, the oldest undo steps are
+	// dropped once this goes over the budget
+	inline size_t getHistorySize() const { return historySize; }
+	inline size_t getHistoryBudget() const { return historyBudget; }
+	inline void setHistoryBudget(size_t historyBudget) { this->historyBudget = historyBudget; trimHistory(); }
+
+private:
+	Map* map;
+	HierarchicalPathfinder* pathfinder;
+	VisibilitySystem* visibility;
+
+	size_t historyBudget;
+	size_t historySize = 0;
+	std::deque<TileDelta> undoStack;
+	std::vector<TileDelta> redoStack;
+
+	TilemapLayer* getLayer(int layer);
+
+	// Compares the area against its contents before the edit
+	TileDelta diff(int layer, TileRect area, const TileRegion& before);
+	void push(TileDelta&& delta);
+	void trimHistory();
+	void apply(const TileDelta& delta, bool undo);
+	void notify(TileRect rect);
+};
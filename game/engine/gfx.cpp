@@ -1,5 +1,8 @@
 #include "gfx.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <array>
 
 TextureAtlas::TextureAtlas(int width, int height, int regionWidth, int regionHeight)
 {
@@ -35,18 +38,21 @@ void TextureAtlas::createGrid()
 
 // Tilemaps
 Tileset::Tileset(std::string name, Texture2D texture, int cellSize)
+	: Tileset(name, TextureHandle(texture), cellSize)
+{
+}
+
+Tileset::Tileset(std::string name, TextureHandle texture, int cellSize)
 {
 	this->name = name;
-	this->texture = texture;
+	this->texture = std::move(texture);
 	this->cellSize = cellSize;
 	generateTiles();
 }
 
 Tileset::~Tileset()
 {
-	for (int i = 0; i < tiles.size(); i++) {
-		delete[] tiles[i];
-	}
+	delete atlas;
 }
 
 Tileset* Tileset::fromFile(std::string path)
@@ -62,7 +68,7 @@ Tileset* Tileset::fromFile(std::string path)
 	nlohmann::json tilesetData = nlohmann::json::parse(jsonString);
 
 	std::string name = tilesetData["name"];
-	Texture2D texture = AssetManager::loadTexture(tilesetData["texture"]);
+	TextureHandle texture = AssetManager::acquireTexture(tilesetData["texture"]);
 	int cellSize = tilesetData["cellSize"];
 
 	Tileset* tileset = new Tileset(name, texture, cellSize);
@@ -70,52 +76,186 @@ Tileset* Tileset::fromFile(std::string path)
 
 	if (tilesetData.contains("tileDatas")) {
 		for (auto& item : tilesetData["tileDatas"].items()) {
-			Tile* tile = tileset->getTileById(std::stoi(item.key()));
-
-			if (item.value().contains("solid")) tile->solid = item.value()["solid"];
-			if (item.value().contains("delay")) tile->animationDelay = item.value()["delay"];
-			
-			if (item.value().contains("solid")) {
-				tile->frames.clear();
-				for (auto& frame : item.value()["frames"]) {
-					tile->frames.push_back(frame);
+			int id = std::stoi(item.key());
+			nlohmann::json& data = item.value();
+
+			if (data.contains("solid")) tileset->setTileSolid(id, data["solid"]);
+			if (data.contains("sound")) tileset->setTileSound(id, SoundBank::load(data["sound"]));
+
+			if (data.contains("frames")) {
+				std::vector<int> frames;
+				for (auto& frame : data["frames"]) {
+					frames.push_back(frame);
 				}
+
+				float delay = data.contains("delay") ? (float)data["delay"] : 0.0f;
+				tileset->setTileFrames(id, frames, delay);
 			}
 		}
 	}
 
+	if (tilesetData.contains("autotiles")) {
+		for (auto& item : tilesetData["autotiles"].items()) {
+			nlohmann::json& data = item.value();
+
+			AutotileRule rule;
+			rule.name = item.key();
+			rule.neighbours = data.contains("neighbours") ? (int)data["neighbours"] : 4;
+
+			// Masks missing from the table fall back to the default tile
+			int fallback = data.contains("default") ? (int)data["default"] : 0;
+			rule.tiles.assign(rule.neighbours == 8 ? 256 : 16, fallback);
+
+			if (data.contains("tiles")) {
+				for (auto& tile : data["tiles"].items()) {
+					int mask = std::stoi(tile.key());
+					if (mask >= 0 && mask < rule.tiles.size()) rule.tiles[mask] = tile.value();
+				}
+			}
+
+			if (data.contains("connectsTo")) {
+				for (auto& other : data["connectsTo"]) {
+					rule.connectsTo.push_back(other);
+				}
+			}
+
+			tileset->addAutotileRule(rule);
+		}
+	}
+
 	return tileset;
 }
 
 void Tileset::generateTiles()
 {
-	atlas = new TextureAtlas(this->texture.width, this->texture.height, this->cellSize, this->cellSize);
+	delete atlas;
+	atlas = new TextureAtlas(this->texture.get().width, this->texture.get().height, this->cellSize, this->cellSize);
 	atlas->createGrid();
 
+	int count = atlas->getRegions().size();
+
 	tiles.clear();
-	for (int i = 0; i < atlas->getRegions().size(); i++)
+	tiles.resize(count);
+	tileSources.assign(count + 1, Rectangle{ 0 });
+	tileFlags.assign(count + 1, 0);
+	animatedTiles.clear();
+
+	for (int i = 0; i < count; i++)
 	{
-		Tile* tile = new Tile;
-		tile->regionIndex = i;
-		tile->id = i + 1;
-		tiles.push_back(tile);
+		tiles[i].regionIndex = i;
+		tiles[i].id = i + 1;
+		tileSources[i + 1] = atlas->getRegion(i);
+	}
+
+	buildAutotileTables();
+}
+
+void Tileset::setTileSolid(int id, bool solid)
+{
+	if (solid) tileFlags[id] |= TILE_SOLID;
+	else tileFlags[id] &= ~TILE_SOLID;
+}
+
+void Tileset::setTileSound(int id, SoundId soundId)
+{
+	getTileById(id)->soundId = soundId;
+
+	if (soundId != INVALID_SOUND) tileFlags[id] |= TILE_HAS_SOUND;
+	else tileFlags[id] &= ~TILE_HAS_SOUND;
+}
+
+void Tileset::setTileFrames(int id, std::vector<int> frames, float delay)
+{
+	Tile* tile = getTileById(id);
+	tile->frames = frames;
+	tile->animationDelay = delay;
+	tile->timer = 0;
+	tile->currentTileId = 0;
+
+	std::erase(animatedTiles, id);
+	tileFlags[id] &= ~TILE_ANIMATED;
+
+	if (!tile->frames.empty()) {
+		animatedTiles.push_back(id);
+		tileFlags[id] |= TILE_ANIMATED;
+		tile->regionIndex = tile->frames[0] - 1;
+		tileSources[id] = atlas->getRegion(tile->regionIndex);
+		sourcesVersion++;
+	}
+}
+
+int Tileset::addAutotileRule(AutotileRule rule)
+{
+	if (rule.neighbours != 4 && rule.neighbours != 8) {
+		TraceLog(LOG_WARNING, ("TILESET: Autotile rule " + rule.name + " needs 4 or 8 neighbours").c_str());
+		return -1;
+	}
+	if (autotileRules.size() >= 255) {
+		TraceLog(LOG_WARNING, ("TILESET: Too many autotile rules, skipped " + rule.name).c_str());
+		return -1;
+	}
+
+	rule.tiles.resize(rule.neighbours == 8 ? 256 : 16, 0);
+	autotileRules.push_back(rule);
+	buildAutotileTables();
+	return autotileRules.size() - 1;
+}
+
+int Tileset::findAutotileRule(std::string name) const
+{
+	for (int i = 0; i < autotileRules.size(); i++) {
+		if (autotileRules[i].name == name) return i;
+	}
+	return -1;
+}
+
+void Tileset::buildAutotileTables()
+{
+	int count = autotileRules.size() + 1;
+
+	tileRules.assign(tileFlags.size(), 0);
+	autotileLinks.assign(count * count, 0);
+
+	for (int i = 0; i < autotileRules.size(); i++) {
+		const AutotileRule& rule = autotileRules[i];
+
+		for (int id : rule.tiles) {
+			if (id <= 0 || id >= tileRules.size()) continue;
+			if (tileRules[id] != 0 && tileRules[id] != i + 1) {
+				TraceLog(LOG_WARNING, ("TILESET: Tile " + std::to_string(id) + " is used by more than one autotile rule").c_str());
+			}
+			tileRules[id] = i + 1;
+		}
+
+		autotileLinks[(i + 1) * count + i + 1] = 1;
+		for (const std::string& other : rule.connectsTo) {
+			int index = findAutotileRule(other);
+			if (index >= 0) autotileLinks[(i + 1) * count + index + 1] = 1;
+		}
 	}
 }
 
 void Tileset::update()
 {
-	for (Tile* tile : tiles) {
-		if (tile->frames.empty()) continue;
+	update(GetFrameTime());
+}
+
+void Tileset::update(float delta)
+{
+	for (int id : animatedTiles) {
+		Tile& tile = tiles[id - 1];
 
-		tile->timer += GetFrameTime();
-		if (tile->timer >= tile->animationDelay) {
-			tile->timer = 0;
+		tile.timer += delta;
+		if (tile.timer >= tile.animationDelay) {
+			tile.timer = 0;
 
-			tile->currentTileId++;
-			if (tile->currentTileId >= tile->frames.size())
-				tile->currentTileId = 0;
+			tile.currentTileId++;
+			if (tile.currentTileId >= tile.frames.size())
+				tile.currentTileId = 0;
 
-			tile->regionIndex = tile->frames[tile->currentTileId] - 1;
+			tile.regionIndex = tile.frames[tile.currentTileId] - 1;
+			tileSources[id] = atlas->getRegion(tile.regionIndex);
+			sourcesVersion++;
 		}
 	}
 }
@@ -134,11 +274,262 @@ TilemapLayer::TilemapLayer(std::string name, Tileset* tileset, int width, int he
 void TilemapLayer::setTile(int tileId, int row, int col)
 {
 	layout[row * width + col] = tileId;
+	markCellDirty(row, col);
+
+	if (tileset && tileset->hasAutotiles()) resolveAutotiles({ row - 1, col - 1, 3, 3 });
 }
 
 void TilemapLayer::eraseTile(int row, int col)
 {
-	layout[row * width + col] = 0;
+	setTile(0, row, col);
+}
+
+// Drops corner bits unless both sides next to the corner are set
+static const std::array<uint8_t, 256> autotileCorners = [] {
+	std::array<uint8_t, 256> table;
+	for (int mask = 0; mask < 256; mask++) {
+		int result = mask & 0x0F;
+		if ((mask & AUTOTILE_NORTH_EAST) && (mask & AUTOTILE_NORTH) && (mask & AUTOTILE_EAST)) result |= AUTOTILE_NORTH_EAST;
+		if ((mask & AUTOTILE_SOUTH_EAST) && (mask & AUTOTILE_SOUTH) && (mask & AUTOTILE_EAST)) result |= AUTOTILE_SOUTH_EAST;
+		if ((mask & AUTOTILE_SOUTH_WEST) && (mask & AUTOTILE_SOUTH) && (mask & AUTOTILE_WEST)) result |= AUTOTILE_SOUTH_WEST;
+		if ((mask & AUTOTILE_NORTH_WEST) && (mask & AUTOTILE_NORTH) && (mask & AUTOTILE_WEST)) result |= AUTOTILE_NORTH_WEST;
+		table[mask] = result;
+	}
+	return table;
+}();
+
+TileRect TilemapLayer::resolveAutotiles(TileRect rect)
+{
+	rect = clipRect(rect);
+	if (rect.isEmpty() || tileset == nullptr || !tileset->hasAutotiles()) return {};
+
+	const std::vector<AutotileRule>& rules = tileset->getAutotileRules();
+	const uint8_t* tileRules = tileset->getTileRules();
+	const uint8_t* links = tileset->getAutotileLinks();
+	int ruleLimit = tileset->getTileCount();
+	int linkStride = rules.size() + 1;
+
+	// Rule of every cell in three rows around the current one, padded by a column on each side.
+	// Resolving only swaps tiles within a rule, so rows can be read before the row above is written.
+	int span = rect.width + 2;
+	std::vector<uint8_t> ruleRows(span * 3);
+
+	auto loadRow = [&](int row, uint8_t* out) {
+		std::fill_n(out, span, 0);
+		if (row < 0 || row >= height) return;
+
+		int first = std::max(rect.col - 1, 0);
+		int last = std::min(rect.col + rect.width, width - 1);
+		const int* line = &layout[row * width];
+		for (int col = first; col <= last; col++) {
+			int id = line[col];
+			out[col - rect.col + 1] = id > 0 && id <= ruleLimit ? tileRules[id] : 0;
+		}
+	};
+
+	loadRow(rect.row - 1, &ruleRows[0]);
+	loadRow(rect.row, &ruleRows[span]);
+
+	int top = height, left = width, bottom = -1, right = -1;
+
+	for (int i = 0; i < rect.height; i++) {
+		const uint8_t* above = &ruleRows[(i % 3) * span];
+		const uint8_t* current = &ruleRows[((i + 1) % 3) * span];
+		uint8_t* below = &ruleRows[((i + 2) % 3) * span];
+		loadRow(rect.row + i + 1, below);
+
+		int* line = &layout[(rect.row + i) * width + rect.col];
+
+		for (int j = 0; j < rect.width; j++) {
+			int rule = current[j + 1];
+			if (rule == 0) continue;
+
+			const uint8_t* link = &links[rule * linkStride];
+			const AutotileRule& data = rules[rule - 1];
+
+			int mask = link[above[j + 1]] | link[current[j + 2]] << 1 | link[below[j + 1]] << 2 | link[current[j]] << 3;
+			if (data.neighbours == 8) {
+				mask |= link[above[j + 2]] << 4 | link[below[j + 2]] << 5 | link[below[j]] << 6 | link[above[j]] << 7;
+				mask = autotileCorners[mask];
+			}
+
+			int id = data.tiles[mask];
+			if (id == 0 || id == line[j]) continue;
+
+			line[j] = id;
+			top = std::min(top, rect.row + i);
+			bottom = rect.row + i;
+			left = std::min(left, rect.col + j);
+			right = std::max(right, rect.col + j);
+		}
+	}
+
+	if (bottom < 0) return {};
+
+	TileRect changed = { top, left, right - left + 1, bottom - top + 1 };
+	markRectDirty(changed);
+	return changed;
+}
+
+void TilemapLayer::markAllDirty()
+{
+	chunkVersions.assign(getChunkRows() * getChunkColumns(), ++version);
+}
+
+void TilemapLayer::markRectDirty(TileRect rect)
+{
+	if (rect.isEmpty()) return;
+
+	int firstRow = rect.row / TILE_CHUNK_SIZE;
+	int lastRow = (rect.row + rect.height - 1) / TILE_CHUNK_SIZE;
+	int firstCol = rect.col / TILE_CHUNK_SIZE;
+	int lastCol = (rect.col + rect.width - 1) / TILE_CHUNK_SIZE;
+	int columns = getChunkColumns();
+
+	version++;
+	for (int chunkRow = firstRow; chunkRow <= lastRow; chunkRow++) {
+		std::fill(&chunkVersions[chunkRow * columns + firstCol], &chunkVersions[chunkRow * columns + lastCol] + 1, version);
+	}
+}
+
+TileRect TilemapLayer::clipRect(TileRect rect) const
+{
+	int top = std::max(rect.row, 0);
+	int left = std::max(rect.col, 0);
+	int bottom = std::min(rect.row + rect.height, height);
+	int right = std::min(rect.col + rect.width, width);
+
+	if (bottom <= top || right <= left) return {};
+	return { top, left, right - left, bottom - top };
+}
+
+TileRect TilemapLayer::fillRect(int tileId, TileRect rect)
+{
+	rect = clipRect(rect);
+	if (rect.isEmpty()) return rect;
+
+	// Fill the first row, then copy it down
+	int* first = &layout[rect.row * width + rect.col];
+	std::fill_n(first, rect.width, tileId);
+	for (int i = 1; i < rect.height; i++) {
+		std::memcpy(first + i * width, first, rect.width * sizeof(int));
+	}
+
+	markRectDirty(rect);
+	return rect;
+}
+
+TileRect TilemapLayer::floodFill(int tileId, int row, int col, std::vector<TileSpan>* spans)
+{
+	if (row < 0 || col < 0 || row >= height || col >= width) return {};
+
+	int target = layout[row * width + col];
+	if (target == tileId) return {};
+
+	int top = row, left = col, bottom = row, right = col;
+	std::vector<std::pair<int, int>> seeds = { { row, col } };
+
+	while (!seeds.empty()) {
+		auto [seedRow, seedCol] = seeds.back();
+		seeds.pop_back();
+
+		int* line = &layout[seedRow * width];
+		if (line[seedCol] != target) continue;
+
+		int start = seedCol;
+		int end = seedCol;
+		while (start > 0 && line[start - 1] == target) start--;
+		while (end < width - 1 && line[end + 1] == target) end++;
+
+		std::fill(line + start, line + end + 1, tileId);
+		if (spans) spans->push_back({ seedRow, start, end - start + 1 });
+
+		top = std::min(top, seedRow);
+		bottom = std::max(bottom, seedRow);
+		left = std::min(left, start);
+		right = std::max(right, end);
+
+		// One seed per run of matching cells on the rows above and below
+		for (int next : { seedRow - 1, seedRow + 1 }) {
+			if (next < 0 || next >= height) continue;
+
+			const int* nextLine = &layout[next * width];
+			for (int i = start; i <= end; i++) {
+				if (nextLine[i] == target && (i == start || nextLine[i - 1] != target)) seeds.push_back({ next, i });
+			}
+		}
+	}
+
+	TileRect rect = { top, left, right - left + 1, bottom - top + 1 };
+	markRectDirty(rect);
+	return rect;
+}
+
+TileRegion TilemapLayer::copyRegion(TileRect rect) const
+{
+	rect = clipRect(rect);
+
+	TileRegion region;
+	region.width = rect.width;
+	region.height = rect.height;
+	region.tiles.resize(rect.width * rect.height);
+
+	for (int i = 0; i < rect.height; i++) {
+		std::memcpy(&region.tiles[i * rect.width], &layout[(rect.row + i) * width + rect.col], rect.width * sizeof(int));
+	}
+
+	return region;
+}
+
+TileRect TilemapLayer::stamp(const TileRegion& region, int row, int col, bool skipEmpty)
+{
+	TileRect rect = clipRect({ row, col, region.width, region.height });
+	if (rect.isEmpty()) return rect;
+
+	int offsetRow = rect.row - row;
+	int offsetCol = rect.col - col;
+
+	for (int i = 0; i < rect.height; i++) {
+		const int* source = &region.tiles[(offsetRow + i) * region.width + offsetCol];
+		int* destination = &layout[(rect.row + i) * width + rect.col];
+
+		if (!skipEmpty) {
+			std::memcpy(destination, source, rect.width * sizeof(int));
+			continue;
+		}
+
+		for (int j = 0; j < rect.width; j++) {
+			if (source[j] != 0) destination[j] = source[j];
+		}
+	}
+
+	markRectDirty(rect);
+	return rect;
+}
+
+TileRect TilemapLayer::blit(const TilemapLayer& source, TileRect from, int row, int col)
+{
+	// Clip against both layers, moving the destination along with the source
+	TileRect clipped = source.clipRect(from);
+	row += clipped.row - from.row;
+	col += clipped.col - from.col;
+
+	TileRect rect = clipRect({ row, col, clipped.width, clipped.height });
+	if (rect.isEmpty()) return rect;
+
+	int sourceRow = clipped.row + rect.row - row;
+	int sourceCol = clipped.col + rect.col - col;
+
+	// Walk rows bottom up when copying down inside the same layer
+	bool reverse = &source == this && rect.row > sourceRow;
+	for (int n = 0; n < rect.height; n++) {
+		int i = reverse ? rect.height - 1 - n : n;
+		std::memmove(&layout[(rect.row + i) * width + rect.col],
+			&source.layout[(sourceRow + i) * source.width + sourceCol], rect.width * sizeof(int));
+	}
+
+	markRectDirty(rect);
+	return rect;
 }
 
 void TilemapLayer::initLayout()
@@ -152,6 +543,8 @@ void TilemapLayer::initLayout()
 			layout[i * width + j] = 0;
 		}
 	}
+
+	markAllDirty();
 }
 
 void TilemapLayer::update()
@@ -171,19 +564,21 @@ void TilemapLayer::draw(const Camera2D& camera, int viewportWidth, int viewportH
 	startRow = std::clamp(startRow, 0, height - 1);
 	endRow = std::clamp(endRow, 0, height - 1);
 
+	Texture2D texture = tileset->getTexture();
+	const Rectangle* sources = tileset->getTileSources();
+
 	for (int i = startRow; i < endRow; i++)
 	{
+		const int* row = &layout[i * width];
+
 		for (int j = startCol; j < endCol; j++)
 		{
-			int id = layout[i * width + j];
+			int id = row[j];
 			if (id <= 0) continue;
 
-			Tile* tile = tileset->getTileById(id);
-			Rectangle tileRect = tileset->getAtlas()->getRegion(tile->regionIndex);
-
 			DrawTextureRec(
-				tileset->getTexture(),
-				tileRect,
+				texture,
+				sources[id],
 				{ (float)cellSize * j, (float)cellSize * i },
 				WHITE
 			);
@@ -214,5 +609,83 @@ void TilemapLayer::resize(int newWidth, int newHeight)
 	this->width = newWidth;
 	this->height = newHeight;
 	layout = std::move(newLayout);
+
+	markAllDirty();
 }
 
+bool TileChunkCache::sync(TilemapLayer* layer, std::vector<int>* dirtyChunks)
+{
+	int chunkColumns = layer->getChunkColumns();
+	int chunkRows = layer->getChunkRows();
+
+	bool reshaped = this->layer != layer || width != layer->getWidth() || height != layer->getHeight();
+	if (reshaped) {
+		this->layer = layer;
+		width = layer->getWidth();
+		height = layer->getHeight();
+		chunks.assign(chunkRows * chunkColumns, nullptr);
+		chunkVersions.assign(chunkRows * chunkColumns, 0);
+	}
+	else if (version == layer->getVersion()) {
+		return false;
+	}
+
+	const int* layout = layer->getLayout();
+
+	for (int chunkRow = 0; chunkRow < chunkRows; chunkRow++) {
+		for (int chunkCol = 0; chunkCol < chunkColumns; chunkCol++) {
+			int index = chunkRow * chunkColumns + chunkCol;
+			uint32_t chunkVersion = layer->getChunkVersion(chunkRow, chunkCol);
+			if (chunks[index] && chunkVersions[index] == chunkVersion) continue;
+
+			std::shared_ptr<TileChunk> chunk = std::make_shared<TileChunk>();
+
+			int startRow = chunkRow * TILE_CHUNK_SIZE;
+			int startCol = chunkCol * TILE_CHUNK_SIZE;
+			int rows = std::min(TILE_CHUNK_SIZE, height - startRow);
+			int cols = std::min(TILE_CHUNK_SIZE, width - startCol);
+
+			for (int i = 0; i < rows; i++) {
+				std::copy_n(&layout[(startRow + i) * width + startCol], cols, &chunk->tiles[i * TILE_CHUNK_SIZE]);
+			}
+
+			chunks[index] = chunk;
+			chunkVersions[index] = chunkVersion;
+			if (dirtyChunks) dirtyChunks->push_back(index);
+		}
+	}
+
+	version = layer->getVersion();
+	return true;
+}
+
+void TileChunkCache::restore(TilemapLayer* layer, int width, int height, const std::vector<std::shared_ptr<const TileChunk>>& chunks)
+{
+	if (layer->getWidth() != width) layer->setWidth(width);
+	if (layer->getHeight() != height) layer->setHeight(height);
+
+	sync(layer);
+
+	int* layout = layer->getLayout();
+	int chunkColumns = layer->getChunkColumns();
+
+	for (int index = 0; index < chunks.size(); index++) {
+		if (this->chunks[index] == chunks[index]) continue;
+
+		int chunkRow = index / chunkColumns;
+		int chunkCol = index % chunkColumns;
+		int startRow = chunkRow * TILE_CHUNK_SIZE;
+		int startCol = chunkCol * TILE_CHUNK_SIZE;
+		int rows = std::min(TILE_CHUNK_SIZE, height - startRow);
+		int cols = std::min(TILE_CHUNK_SIZE, width - startCol);
+
+		for (int i = 0; i < rows; i++) {
+			std::copy_n(&chunks[index]->tiles[i * TILE_CHUNK_SIZE], cols, &layout[(startRow + i) * width + startCol]);
+		}
+
+		this->chunks[index] = chunks[index];
+		chunkVersions[index] = layer->markChunkDirty(chunkRow, chunkCol);
+	}
+
+	version = layer->getVersion();
+}
@@ -5,6 +5,9 @@
 #include <string>
 #include <memory>
 #include <fstream>
+#include <cstdint>
+#include "utils.hpp"
+#include "audio.hpp"
 
 class TextureAtlas
 {
@@ -33,14 +36,21 @@ private:
 
 
 // Map-related graphics
+enum TileFlags : uint8_t
+{
+	TILE_SOLID = 1 << 0,
+	TILE_ANIMATED = 1 << 1,
+	TILE_HAS_SOUND = 1 << 2
+};
+
+// Cold per-tile metadata. What the draw and navigation loops need lives in
+// the tileset's flat source / flag arrays instead.
 struct Tile
 {
 	int id = 1;
 	int regionIndex = 0;
 
-	bool solid = false;
-
-	std::string* soundPath = nullptr;
+	SoundId soundId = INVALID_SOUND;
 
 	float timer = 0;
 	int currentTileId = 0;
@@ -48,11 +58,40 @@ struct Tile
 	std::vector<int> frames;
 };
 
+// Neighbour bits of an autotile mask. 4-neighbour rules only use the first
+// four, 8-neighbour rules count a corner only when both sides next to it match.
+enum AutotileBits
+{
+	AUTOTILE_NORTH = 1 << 0,
+	AUTOTILE_EAST = 1 << 1,
+	AUTOTILE_SOUTH = 1 << 2,
+	AUTOTILE_WEST = 1 << 3,
+	AUTOTILE_NORTH_EAST = 1 << 4,
+	AUTOTILE_SOUTH_EAST = 1 << 5,
+	AUTOTILE_SOUTH_WEST = 1 << 6,
+	AUTOTILE_NORTH_WEST = 1 << 7
+};
+
+// Maps the neighbour mask of a cell to the tile it should show. Every tile
+// in the table belongs to the rule, so painting any of them gets resolved.
+struct AutotileRule
+{
+	std::string name;
+	int neighbours = 4;
+	// 16 entries for 4 neighbours, 256 for 8, 0 keeps the painted tile
+	std::vector<int> tiles;
+	// Other rules whose tiles count as matching neighbours
+	std::vector<std::string> connectsTo;
+};
+
 class Tileset
 {
 public:
 	Tileset() {}
 	Tileset(std::string name, Texture2D texture, int cellSize);
+	Tileset(std::string name, TextureHandle texture, int cellSize);
+	Tileset(const Tileset&) = delete;
+	Tileset& operator=(const Tileset&) = delete;
 	~Tileset();
 
 	static Tileset* fromFile(std::string path);
@@ -63,9 +102,11 @@ public:
 	inline std::string getTexturePathInfo() const { return texturePathInfo; }
 	inline void setTexturePathInfo(std::string path) { texturePathInfo = path; }
 
-	inline Texture2D getTexture() const { return texture; }
-	inline void setTexture(Texture2D texture) {
-		this->texture = texture;
+	inline Texture2D getTexture() const { return texture.get(); }
+	inline TextureHandle& getTextureHandle() { return texture; }
+	inline void setTexture(Texture2D texture) { setTexture(TextureHandle(texture)); }
+	inline void setTexture(TextureHandle texture) {
+		this->texture = std::move(texture);
 		generateTiles();
 	}
 
@@ -75,27 +116,92 @@ public:
 		generateTiles();
 	}
 
-	inline int getRows() { return texture.height / cellSize; }
-	inline int getColumns() { return texture.width / cellSize; }
+	inline int getRows() { return texture.get().height / cellSize; }
+	inline int getColumns() { return texture.get().width / cellSize; }
 
 	inline TextureAtlas* getAtlas() { return atlas; }
 
-	inline std::vector<Tile*> getTiles() { return tiles; }
-	inline Tile* getTile(int index) { return tiles[index]; }
+	inline std::vector<Tile>& getTiles() { return tiles; }
+	inline Tile* getTile(int index) { return &tiles[index]; }
 	inline Tile* getTileById(int id) { return getTile(id - 1); }
+	inline int getTileCount() const { return tiles.size(); }
+
+	// Indexed by tile id, entry 0 stands for an empty cell
+	inline const Rectangle* getTileSources() const { return tileSources.data(); }
+	inline const uint8_t* getTileFlags() const { return tileFlags.data(); }
+
+	inline Rectangle getTileSource(int id) const { return tileSources[id]; }
+	inline bool isTileSolid(int id) const { return tileFlags[id] & TILE_SOLID; }
+	void setTileSolid(int id, bool solid);
+	void setTileSound(int id, SoundId soundId);
+	void setTileFrames(int id, std::vector<int> frames, float delay);
+
+	// Bumped whenever an animated tile changes its source rect
+	inline uint32_t getSourcesVersion() const { return sourcesVersion; }
+
+	inline bool hasAutotiles() const { return !autotileRules.empty(); }
+	inline const std::vector<AutotileRule>& getAutotileRules() const { return autotileRules; }
+	// Indexed by tile id, 0 for no rule, otherwise the rule index + 1
+	inline const uint8_t* getTileRules() const { return tileRules.data(); }
+	// Square table over rule index + 1, non-zero where the first rule connects to the second
+	inline const uint8_t* getAutotileLinks() const { return autotileLinks.data(); }
+	int addAutotileRule(AutotileRule rule);
+	int findAutotileRule(std::string name) const;
 
 	void generateTiles();
 	void update();
+	void update(float delta);
 
 private:
 	std::string name;
 
-	Texture2D texture;
+	TextureHandle texture;
 	std::string texturePathInfo;
 	int cellSize;
 
-	TextureAtlas* atlas;
-	std::vector<Tile*> tiles;
+	TextureAtlas* atlas = nullptr;
+	std::vector<Tile> tiles;
+
+	std::vector<Rectangle> tileSources;
+	std::vector<uint8_t> tileFlags;
+	std::vector<int> animatedTiles;
+	uint32_t sourcesVersion = 0;
+
+	std::vector<AutotileRule> autotileRules;
+	std::vector<uint8_t> tileRules;
+	std::vector<uint8_t> autotileLinks;
+
+	void buildAutotileTables();
+};
+
+// Side of the square tile chunks used for change tracking
+#define TILE_CHUNK_SIZE 16
+
+// Cell rectangle on a layer, width or height of 0 means nothing
+struct TileRect
+{
+	int row = 0;
+	int col = 0;
+	int width = 0;
+	int height = 0;
+
+	inline bool isEmpty() const { return width <= 0 || height <= 0; }
+};
+
+// Horizontal run of cells, as produced by flood fills and edit deltas
+struct TileSpan
+{
+	int row;
+	int col;
+	int length;
+};
+
+// Row-major block of tile ids, used for copy and paste
+struct TileRegion
+{
+	int width = 0;
+	int height = 0;
+	std::vector<int> tiles;
 };
 
 enum TileRenderType
@@ -132,8 +238,42 @@ public:
 	void setTile(int tileId, int row, int col);
 	void eraseTile(int row, int col);
 
+	// Bulk edits. Rectangles are clipped to the layer, the return value is the
+	// rectangle that was written, already marked dirty with a single version.
+	TileRect clipRect(TileRect rect) const;
+	TileRect fillRect(int tileId, TileRect rect);
+	// 4-connected scanline fill, optionally reporting the filled runs
+	TileRect floodFill(int tileId, int row, int col, std::vector<TileSpan>* spans = nullptr);
+	TileRegion copyRegion(TileRect rect) const;
+	// With skipEmpty, zero tiles in the region leave the layer untouched
+	TileRect stamp(const TileRegion& region, int row, int col, bool skipEmpty = false);
+	// Copies a rectangle from another layer, or from this one with overlap
+	TileRect blit(const TilemapLayer& source, TileRect from, int row, int col);
+
+	// Re-picks autotiled cells in the rectangle from their neighbours, one row
+	// at a time. setTile does this around the cell it changes, bulk edits leave
+	// it to the caller. Returns the rectangle of cells that changed.
+	TileRect resolveAutotiles(TileRect rect);
+	inline TileRect resolveAutotiles() { return resolveAutotiles({ 0, 0, width, height }); }
+
 	void initLayout();
 
+	// Every edit stamps its chunk with a new layer version, so consumers can
+	// tell which chunks changed since they last looked.
+	// Writes made through getLayout() must be followed by markCellDirty.
+	inline uint32_t getVersion() const { return version; }
+	inline int getChunkColumns() const { return (width + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE; }
+	inline int getChunkRows() const { return (height + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE; }
+	inline uint32_t getChunkVersion(int chunkRow, int chunkCol) const { return chunkVersions[chunkRow * getChunkColumns() + chunkCol]; }
+	inline void markCellDirty(int row, int col) {
+		chunkVersions[(row / TILE_CHUNK_SIZE) * getChunkColumns() + col / TILE_CHUNK_SIZE] = ++version;
+	}
+	inline uint32_t markChunkDirty(int chunkRow, int chunkCol) {
+		return chunkVersions[chunkRow * getChunkColumns() + chunkCol] = ++version;
+	}
+	void markAllDirty();
+	void markRectDirty(TileRect rect);
+
 	void update();
 	void draw(const Camera2D& camera, int viewportWidth, int viewportHeight);
 
@@ -148,6 +288,37 @@ private:
 
 	std::unique_ptr<int[]> layout;
 
+	uint32_t version = 0;
+	std::vector<uint32_t> chunkVersions;
+
 	void resize(int width, int height);
 };
 
+// Immutable copy of a TILE_CHUNK_SIZE square of a layer layout
+struct TileChunk
+{
+	int tiles[TILE_CHUNK_SIZE * TILE_CHUNK_SIZE] = { 0 };
+};
+
+// Mirrors a layer as shared immutable chunks. Only chunks whose version
+// changed get copied, so holders of older chunk lists share the rest.
+class TileChunkCache
+{
+public:
+	inline int getWidth() const { return width; }
+	inline int getHeight() const { return height; }
+	inline const std::vector<std::shared_ptr<const TileChunk>>& getChunks() const { return chunks; }
+
+	// Returns false when nothing changed since the last sync
+	bool sync(TilemapLayer* layer, std::vector<int>* dirtyChunks = nullptr);
+	// Writes chunks back into the layer, skipping the ones it already holds
+	void restore(TilemapLayer* layer, int width, int height, const std::vector<std::shared_ptr<const TileChunk>>& chunks);
+
+private:
+	TilemapLayer* layer = nullptr;
+	int width = 0;
+	int height = 0;
+	uint32_t version = 0;
+	std::vector<uint32_t> chunkVersions;
+	std::vector<std::shared_ptr<const TileChunk>> chunks;
+};
@@ -0,0 +1,260 @@
+#include "particles.hpp"
+#include <rlgl.h>
+#include <algorithm>
+#include <cmath>
+
+// Max quads submitted between render batch limit checks
+#define PARTICLE_BATCH_QUADS 1024
+
+// Curves
+void SizeCurve::addKey(float time, float value)
+{
+	// A key at the same time replaces the old one, including the default key at 0
+	auto existing = std::find_if(keys.begin(), keys.end(), [time](auto& key) { return key.first == time; });
+	if (existing != keys.end()) existing->second = value;
+	else {
+		keys.push_back({ time, value });
+		std::sort(keys.begin(), keys.end(), [](auto& a, auto& b) { return a.first < b.first; });
+	}
+	bake();
+}
+
+void SizeCurve::bake()
+{
+	for (int i = 0; i < SAMPLES; i++) {
+		float time = (float)i / (SAMPLES - 1);
+
+		auto next = std::find_if(keys.begin(), keys.end(), [time](auto& key) { return key.first >= time; });
+		if (next == keys.begin()) table[i] = next->second;
+		else if (next == keys.end()) table[i] = keys.back().second;
+		else {
+			auto prev = next - 1;
+			float t = (time - prev->first) / (next->first - prev->first);
+			table[i] = prev->second + (next->second - prev->second) * t;
+		}
+	}
+}
+
+void ColorCurve::addKey(float time, Color color)
+{
+	// A key at the same time replaces the old one, including the default key at 0
+	auto existing = std::find_if(keys.begin(), keys.end(), [time](auto& key) { return key.first == time; });
+	if (existing != keys.end()) existing->second = color;
+	else {
+		keys.push_back({ time, color });
+		std::sort(keys.begin(), keys.end(), [](auto& a, auto& b) { return a.first < b.first; });
+	}
+	bake();
+}
+
+void ColorCurve::bake()
+{
+	for (int i = 0; i < SAMPLES; i++) {
+		float time = (float)i / (SAMPLES - 1);
+
+		auto next = std::find_if(keys.begin(), keys.end(), [time](auto& key) { return key.first >= time; });
+		if (next == keys.begin()) table[i] = next->second;
+		else if (next == keys.end()) table[i] = keys.back().second;
+		else {
+			auto prev = next - 1;
+			float t = (time - prev->first) / (next->first - prev->first);
+			table[i] = {
+				(unsigned char)(prev->second.r + (next->second.r - prev->second.r) * t),
+				(unsigned char)(prev->second.g + (next->second.g - prev->second.g) * t),
+				(unsigned char)(prev->second.b + (next->second.b - prev->second.b) * t),
+				(unsigned char)(prev->second.a + (next->second.a - prev->second.a) * t)
+			};
+		}
+	}
+}
+
+// Pool
+void ParticlePool::allocate(int capacity)
+{
+	this->capacity = capacity;
+	this->count = 0;
+
+	x = std::make_unique<float[]>(capacity);
+	y = std::make_unique<float[]>(capacity);
+	velocityX = std::make_unique<float[]>(capacity);
+	velocityY = std::make_unique<float[]>(capacity);
+	life = std::make_unique<float[]>(capacity);
+	lifeRate = std::make_unique<float[]>(capacity);
+	region = std::make_unique<uint16_t[]>(capacity);
+}
+
+void ParticlePool::kill(int index)
+{
+	int last = --count;
+	x[index] = x[last];
+	y[index] = y[last];
+	velocityX[index] = velocityX[last];
+	velocityY[index] = velocityY[last];
+	life[index] = life[last];
+	lifeRate[index] = lifeRate[last];
+	region[index] = region[last];
+}
+
+// Emitter
+ParticleEmitter::ParticleEmitter(TextureHandle texture, TextureAtlas* atlas, EmitterSettings settings, int capacity)
+{
+	this->texture = std::move(texture);
+	this->atlas = atlas;
+	this->settings = settings;
+
+	if (this->settings.regions.empty()) this->settings.regions.push_back(0);
+	pool.allocate(capacity);
+}
+
+int ParticleEmitter::burst(int amount)
+{
+	int spawned = std::min(amount, pool.capacity - pool.count);
+	int regionCount = settings.regions.size();
+
+	for (int i = 0; i < spawned; i++) {
+		int index = pool.count++;
+
+		float angle = (settings.direction + random(-0.5f, 0.5f) * settings.spread) * DEG2RAD;
+		float speed = random(settings.minSpeed, settings.maxSpeed);
+
+		pool.x[index] = settings.position.x;
+		pool.y[index] = settings.position.y;
+		pool.velocityX[index] = std::cos(angle) * speed;
+		pool.velocityY[index] = std::sin(angle) * speed;
+		pool.life[index] = 0;
+		pool.lifeRate[index] = 1.0f / std::max(random(settings.minLife, settings.maxLife), 0.001f);
+		pool.region[index] = settings.animateRegions ? 0 : (uint16_t)std::min((int)(random() * regionCount), regionCount - 1);
+	}
+
+	return spawned;
+}
+
+void ParticleEmitter::update(float delta)
+{
+	if (emitting && settings.rate > 0) {
+		emitAccumulator += settings.rate * delta;
+		int amount = (int)emitAccumulator;
+		emitAccumulator -= amount;
+		burst(amount);
+	}
+
+	int count = pool.count;
+	float* x = pool.x.get();
+	float* y = pool.y.get();
+	float* velocityX = pool.velocityX.get();
+	float* velocityY = pool.velocityY.get();
+	float* life = pool.life.get();
+	const float* lifeRate = pool.lifeRate.get();
+
+	float gravityX = settings.gravity.x * delta;
+	float gravityY = settings.gravity.y * delta;
+	float damping = std::max(1.0f - settings.drag * delta, 0.0f);
+
+	// Straight-line integration over the attribute arrays, no branches
+	for (int i = 0; i < count; i++) {
+		velocityX[i] = (velocityX[i] + gravityX) * damping;
+		velocityY[i] = (velocityY[i] + gravityY) * damping;
+		x[i] += velocityX[i] * delta;
+		y[i] += velocityY[i] * delta;
+		life[i] += lifeRate[i] * delta;
+	}
+
+	for (int i = 0; i < pool.count;) {
+		if (life[i] >= 1.0f) pool.kill(i);
+		else i++;
+	}
+
+	if (settings.animateRegions) {
+		int regionCount = settings.regions.size();
+		for (int i = 0; i < pool.count; i++) {
+			pool.region[i] = (uint16_t)std::min((int)(life[i] * regionCount), regionCount - 1);
+		}
+	}
+}
+
+void ParticleEmitter::draw()
+{
+	if (pool.count == 0) return;
+
+	Texture2D tex = texture.get();
+	float inverseWidth = 1.0f / tex.width;
+	float inverseHeight = 1.0f / tex.height;
+
+	// Texture coordinates per region are resolved once per draw, not per particle
+	int regionCount = settings.regions.size();
+	std::vector<Rectangle> sources(regionCount);
+	for (int i = 0; i < regionCount; i++) {
+		Rectangle region = atlas->getRegion(settings.regions[i]);
+		sources[i] = { region.x * inverseWidth, region.y * inverseHeight,
+			(region.x + region.width) * inverseWidth, (region.y + region.height) * inverseHeight };
+	}
+
+	float regionWidth = (float)atlas->getRegionWidth();
+	float regionHeight = (float)atlas->getRegionHeight();
+
+	for (int start = 0; start < pool.count; start += PARTICLE_BATCH_QUADS) {
+		int end = std::min(start + PARTICLE_BATCH_QUADS, pool.count);
+		rlCheckRenderBatchLimit((end - start) * 4);
+
+		rlSetTexture(tex.id);
+		rlBegin(RL_QUADS);
+		rlNormal3f(0.0f, 0.0f, 1.0f);
+
+		for (int i = start; i < end; i++) {
+			float life = pool.life[i];
+			Color color = settings.color.sample(life);
+			float scale = settings.size.sample(life);
+			const Rectangle& uv = sources[pool.region[i]];
+
+			float halfWidth = regionWidth * scale * 0.5f;
+			float halfHeight = regionHeight * scale * 0.5f;
+			float left = pool.x[i] - halfWidth;
+			float top = pool.y[i] - halfHeight;
+			float right = pool.x[i] + halfWidth;
+			float bottom = pool.y[i] + halfHeight;
+
+			rlColor4ub(color.r, color.g, color.b, color.a);
+			rlTexCoord2f(uv.x, uv.y);
+			rlVertex2f(left, top);
+			rlTexCoord2f(uv.x, uv.height);
+			rlVertex2f(left, bottom);
+			rlTexCoord2f(uv.width, uv.height);
+			rlVertex2f(right, bottom);
+			rlTexCoord2f(uv.width, uv.y);
+			rlVertex2f(right, top);
+		}
+
+		rlEnd();
+	}
+
+	rlSetTexture(0);
+}
+
+// System
+ParticleEmitter* ParticleSystem::addEmitter(TextureHandle texture, TextureAtlas* atlas, EmitterSettings settings, int capacity)
+{
+	emitters.push_back(std::make_unique<ParticleEmitter>(std::move(texture), atlas, settings, capacity));
+	return emitters.back().get();
+}
+
+void ParticleSystem::removeEmitter(ParticleEmitter* emitter)
+{
+	std::erase_if(emitters, [emitter](auto& item) { return item.get() == emitter; });
+}
+
+int ParticleSystem::getLiveCount() const
+{
+	int count = 0;
+	for (auto& emitter : emitters) count += emitter->getCount();
+	return count;
+}
+
+void ParticleSystem::update(float delta)
+{
+	for (auto& emitter : emitters) emitter->update(delta);
+}
+
+void ParticleSystem::draw()
+{
+	for (auto& emitter : emitters) emitter->draw();
+}
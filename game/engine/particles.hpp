@@ -0,0 +1,141 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "utils.hpp"
+#include "gfx.hpp"
+
+// Piecewise-linear curves over normalized particle life (0 = born, 1 = dead),
+// baked into a small lookup table so particles never search keys
+class SizeCurve
+{
+public:
+	static const int SAMPLES = 64;
+
+	SizeCurve(float value = 1) { addKey(0, value); }
+
+	void addKey(float time, float value);
+	inline float sample(float life) const { return table[(int)(life * (SAMPLES - 1))]; }
+
+private:
+	std::vector<std::pair<float, float>> keys;
+	float table[SAMPLES];
+
+	void bake();
+};
+
+class ColorCurve
+{
+public:
+	static const int SAMPLES = 64;
+
+	ColorCurve(Color color = WHITE) { addKey(0, color); }
+
+	void addKey(float time, Color color);
+	inline Color sample(float life) const { return table[(int)(life * (SAMPLES - 1))]; }
+
+private:
+	std::vector<std::pair<float, Color>> keys;
+	Color table[SAMPLES];
+
+	void bake();
+};
+
+struct EmitterSettings
+{
+	Vector2 position = { 0, 0 };
+	Vector2 gravity = { 0, 0 };
+	float drag = 0;
+
+	// Particles per second, 0 for burst-only emitters
+	float rate = 0;
+
+	float minLife = 0.5f;
+	float maxLife = 1.0f;
+	float minSpeed = 10;
+	float maxSpeed = 40;
+	// Degrees, 0 points right
+	float direction = 0;
+	float spread = 360;
+
+	// Atlas region indices to draw; picked randomly per particle unless animated
+	std::vector<int> regions;
+	bool animateRegions = false;
+
+	SizeCurve size;
+	ColorCurve color;
+};
+
+// Fixed-capacity particle storage, one array per attribute
+struct ParticlePool
+{
+	int capacity = 0;
+	int count = 0;
+
+	std::unique_ptr<float[]> x;
+	std::unique_ptr<float[]> y;
+	std::unique_ptr<float[]> velocityX;
+	std::unique_ptr<float[]> velocityY;
+	std::unique_ptr<float[]> life;
+	std::unique_ptr<float[]> lifeRate;
+	std::unique_ptr<uint16_t[]> region;
+
+	void allocate(int capacity);
+	void kill(int index);
+};
+
+class ParticleEmitter
+{
+public:
+	ParticleEmitter(TextureHandle texture, TextureAtlas* atlas, EmitterSettings settings, int capacity);
+
+	inline EmitterSettings& getSettings() { return settings; }
+	inline void setPosition(Vector2 position) { settings.position = position; }
+
+	inline int getCount() const { return pool.count; }
+	inline int getCapacity() const { return pool.capacity; }
+
+	inline bool isEmitting() const { return emitting; }
+	inline void setEmitting(bool emitting) { this->emitting = emitting; }
+
+	// Returns how many particles were actually spawned
+	int burst(int amount);
+
+	void update(float delta);
+	void draw();
+
+private:
+	TextureHandle texture;
+	TextureAtlas* atlas;
+	EmitterSettings settings;
+	ParticlePool pool;
+
+	bool emitting = true;
+	float emitAccumulator = 0;
+	uint32_t seed = 0x9E3779B9;
+
+	inline float random() {
+		seed ^= seed << 13;
+		seed ^= seed >> 17;
+		seed ^= seed << 5;
+		return (seed >> 8) * (1.0f / 16777216.0f);
+	}
+	inline float random(float min, float max) { return min + (max - min) * random(); }
+};
+
+class ParticleSystem
+{
+public:
+	ParticleEmitter* addEmitter(TextureHandle texture, TextureAtlas* atlas, EmitterSettings settings, int capacity);
+	void removeEmitter(ParticleEmitter* emitter);
+
+	inline std::vector<std::unique_ptr<ParticleEmitter>>& getEmitters() { return emitters; }
+	int getLiveCount() const;
+
+	void update(float delta);
+	void draw();
+
+private:
+	std::vector<std::unique_ptr<ParticleEmitter>> emitters;
+};
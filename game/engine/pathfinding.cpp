@@ -0,0 +1,540 @@
+#include "pathfinding.hpp"
+#include <algorithm>
+#include <chrono>
+#include <queue>
+
+// Straight and diagonal step costs
+#define STEP_COST 10
+#define DIAGONAL_COST 14
+
+// Cached routes kept before the least recently used ones are dropped
+#define MAX_CACHED_PATHS 1024
+
+// Entrances at least this wide get a node at each end instead of the middle
+#define WIDE_ENTRANCE 6
+
+static const int directions[8][2] = {
+	{ -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+	{ -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 }
+};
+
+static inline int octile(GridCell a, GridCell b)
+{
+	int dr = std::abs(a.row - b.row);
+	int dc = std::abs(a.col - b.col);
+	return STEP_COST * (dr + dc) + (DIAGONAL_COST - 2 * STEP_COST) * std::min(dr, dc);
+}
+
+HierarchicalPathfinder::HierarchicalPathfinder(Map* map, int clusterSize)
+{
+	this->map = map;
+	this->clusterSize = clusterSize;
+	rebuild();
+}
+
+// Graph
+int HierarchicalPathfinder::addNode(GridCell cell, int cluster)
+{
+	int id;
+	if (!freeNodes.empty()) {
+		id = freeNodes.back();
+		freeNodes.pop_back();
+	}
+	else {
+		id = nodes.size();
+		nodes.emplace_back();
+	}
+
+	nodes[id].cell = cell;
+	nodes[id].cluster = cluster;
+	nodes[id].active = true;
+	nodes[id].edges.clear();
+	clusterNodes[cluster].push_back(id);
+	return id;
+}
+
+void HierarchicalPathfinder::removeNode(int id)
+{
+	Node& node = nodes[id];
+
+	for (const Edge& edge : node.edges) {
+		std::erase_if(nodes[edge.to].edges, [id](const Edge& item) { return item.to == id; });
+	}
+
+	node.edges.clear();
+	node.active = false;
+	std::erase(clusterNodes[node.cluster], id);
+	freeNodes.push_back(id);
+}
+
+void HierarchicalPathfinder::connect(int a, int b, int cost)
+{
+	nodes[a].edges.push_back({ b, cost });
+	nodes[b].edges.push_back({ a, cost });
+}
+
+void HierarchicalPathfinder::clusterBounds(int cluster, int& top, int& left, int& bottom, int& right) const
+{
+	top = (cluster / clusterColumns) * clusterSize;
+	left = (cluster % clusterColumns) * clusterSize;
+	bottom = std::min(top + clusterSize, height) - 1;
+	right = std::min(left + clusterSize, width) - 1;
+}
+
+void HierarchicalPathfinder::buildBorder(int cluster, int direction)
+{
+	std::vector<int>& border = borderNodes[cluster * 2 + direction];
+	for (int id : border) removeNode(id);
+	border.clear();
+
+	int top, left, bottom, right;
+	clusterBounds(cluster, top, left, bottom, right);
+
+	// Cells along the border on this side, and the offset to the other side
+	bool vertical = direction == 0;
+	if (vertical && right + 1 >= width) return;
+	if (!vertical && bottom + 1 >= height) return;
+
+	int neighbour = cluster + (vertical ? 1 : clusterColumns);
+	int first = vertical ? top : left;
+	int last = vertical ? bottom : right;
+
+	auto cellAt = [&](int i) { return vertical ? GridCell{ i, right } : GridCell{ bottom, i }; };
+	auto open = [&](int i) {
+		GridCell cell = cellAt(i);
+		return isWalkable(cell.row, cell.col) && isWalkable(cell.row + !vertical, cell.col + vertical);
+	};
+	auto addEntrance = [&](int i) {
+		GridCell inside = cellAt(i);
+		GridCell outside = { inside.row + !vertical, inside.col + vertical };
+
+		int a = addNode(inside, cluster);
+		int b = addNode(outside, neighbour);
+		connect(a, b, STEP_COST);
+		border.push_back(a);
+		border.push_back(b);
+	};
+
+	for (int i = first; i <= last;) {
+		if (!open(i)) {
+			i++;
+			continue;
+		}
+
+		int start = i;
+		while (i <= last && open(i)) i++;
+		int end = i - 1;
+
+		if (end - start + 1 >= WIDE_ENTRANCE) {
+			addEntrance(start);
+			addEntrance(end);
+		}
+		else {
+			addEntrance((start + end) / 2);
+		}
+	}
+}
+
+void HierarchicalPathfinder::buildIntraEdges(int cluster)
+{
+	std::vector<int>& members = clusterNodes[cluster];
+
+	for (int id : members) {
+		std::erase_if(nodes[id].edges, [&](const Edge& edge) { return nodes[edge.to].cluster == cluster; });
+	}
+
+	int top, left, bottom, right;
+	clusterBounds(cluster, top, left, bottom, right);
+
+	for (int i = 0; i < members.size(); i++) {
+		searchCells(nodes[members[i]].cell, top, left, bottom, right, nullptr);
+
+		for (int j = i + 1; j < members.size(); j++) {
+			GridCell cell = nodes[members[j]].cell;
+			int index = cell.row * width + cell.col;
+			if (cellStamp[index] == cellSearch) connect(members[i], members[j], cellCost[index]);
+		}
+	}
+}
+
+void HierarchicalPathfinder::rebuild()
+{
+	if (map->getNavigationMap().size() != map->getWidth() * map->getHeight()) {
+		map->generateNavigationMap();
+	}
+
+	width = map->getWidth();
+	height = map->getHeight();
+	clusterColumns = (width + clusterSize - 1) / clusterSize;
+	clusterRows = (height + clusterSize - 1) / clusterSize;
+	int clusterCount = clusterColumns * clusterRows;
+
+	cellCost.assign(width * height, 0);
+	cellParent.assign(width * height, -1);
+	cellStamp.assign(width * height, 0);
+	cellSearch = 0;
+
+	nodes.clear();
+	freeNodes.clear();
+	clusterNodes.assign(clusterCount, {});
+	borderNodes.assign(clusterCount * 2, {});
+	dirtyClusters.assign(clusterCount, 0);
+	hasDirtyClusters = false;
+
+	for (int cluster = 0; cluster < clusterCount; cluster++) {
+		buildBorder(cluster, 0);
+		buildBorder(cluster, 1);
+	}
+
+	for (int cluster = 0; cluster < clusterCount; cluster++) {
+		buildIntraEdges(cluster);
+	}
+
+	for (auto& entry : cache) entry.second.route->valid = false;
+	stats.invalidated += cache.size();
+	cache.clear();
+}
+
+void HierarchicalPathfinder::notifyTileChanged(int row, int col)
+{
+	int cluster = clusterOf(row, col);
+	if (!dirtyClusters[cluster]) {
+		dirtyClusters[cluster] = 1;
+		hasDirtyClusters = true;
+	}
+
+	invalidateCluster(cluster);
+}
+
+void HierarchicalPathfinder::notifyRegionChanged(TileRect rect)
+{
+	if (rect.isEmpty()) return;
+
+	int firstRow = rect.row / clusterSize;
+	int lastRow = (rect.row + rect.height - 1) / clusterSize;
+	int firstCol = rect.col / clusterSize;
+	int lastCol = (rect.col + rect.width - 1) / clusterSize;
+
+	for (int row = firstRow; row <= lastRow; row++) {
+		for (int col = firstCol; col <= lastCol; col++) {
+			notifyTileChanged(row * clusterSize, col * clusterSize);
+		}
+	}
+}
+
+void HierarchicalPathfinder::invalidateCluster(int cluster)
+{
+	for (auto it = cache.begin(); it != cache.end();) {
+		std::vector<int>& clusters = it->second.route->waypointClusters;
+		if (std::find(clusters.begin(), clusters.end(), cluster) == clusters.end()) {
+			it++;
+			continue;
+		}
+
+		it->second.route->valid = false;
+		it = cache.erase(it);
+		stats.invalidated++;
+	}
+}
+
+void HierarchicalPathfinder::applyDirtyClusters()
+{
+	if (!hasDirtyClusters) return;
+
+	std::vector<int> affected;
+	for (int cluster = 0; cluster < dirtyClusters.size(); cluster++) {
+		if (!dirtyClusters[cluster]) continue;
+		dirtyClusters[cluster] = 0;
+
+		int row = cluster / clusterColumns;
+		int col = cluster % clusterColumns;
+
+		// Every border of the cluster, including the ones owned by the neighbours above and to the left
+		buildBorder(cluster, 0);
+		buildBorder(cluster, 1);
+		if (col > 0) buildBorder(cluster - 1, 0);
+		if (row > 0) buildBorder(cluster - clusterColumns, 1);
+
+		affected.push_back(cluster);
+		if (col > 0) affected.push_back(cluster - 1);
+		if (col < clusterColumns - 1) affected.push_back(cluster + 1);
+		if (row > 0) affected.push_back(cluster - clusterColumns);
+		if (row < clusterRows - 1) affected.push_back(cluster + clusterColumns);
+	}
+
+	std::sort(affected.begin(), affected.end());
+	affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+	for (int cluster : affected) buildIntraEdges(cluster);
+
+	hasDirtyClusters = false;
+}
+
+// Cell level search
+void HierarchicalPathfinder::searchCells(GridCell start, int top, int left, int bottom, int right, const GridCell* goal)
+{
+	using Item = std::pair<int, int>;
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+
+	cellSearch++;
+	int startIndex = start.row * width + start.col;
+	cellStamp[startIndex] = cellSearch;
+	cellCost[startIndex] = 0;
+	cellParent[startIndex] = -1;
+	open.push({ goal ? octile(start, *goal) : 0, startIndex });
+
+	while (!open.empty()) {
+		auto [priority, current] = open.top();
+		open.pop();
+
+		GridCell cell = { current / width, current % width };
+		int cost = cellCost[current];
+		if (priority - (goal ? octile(cell, *goal) : 0) > cost) continue;
+		if (goal && cell == *goal) return;
+
+		for (int d = 0; d < 8; d++) {
+			int row = cell.row + directions[d][0];
+			int col = cell.col + directions[d][1];
+			if (row < top || row > bottom || col < left || col > right) continue;
+			if (!isWalkable(row, col)) continue;
+
+			bool diagonal = d >= 4;
+			if (diagonal && (!isWalkable(cell.row, col) || !isWalkable(row, cell.col))) continue;
+
+			int index = row * width + col;
+			int newCost = cost + (diagonal ? DIAGONAL_COST : STEP_COST);
+			if (cellStamp[index] == cellSearch && cellCost[index] <= newCost) continue;
+
+			cellStamp[index] = cellSearch;
+			cellCost[index] = newCost;
+			cellParent[index] = current;
+			open.push({ newCost + (goal ? octile({ row, col }, *goal) : 0), index });
+		}
+	}
+}
+
+bool HierarchicalPathfinder::tracePath(GridCell start, GridCell goal, std::vector<GridCell>& out)
+{
+	int goalIndex = goal.row * width + goal.col;
+	if (cellStamp[goalIndex] != cellSearch) return false;
+
+	int startIndex = start.row * width + start.col;
+	size_t first = out.size();
+	for (int index = goalIndex; index != startIndex; index = cellParent[index]) {
+		out.push_back({ index / width, index % width });
+	}
+
+	std::reverse(out.begin() + first, out.end());
+	return true;
+}
+
+// Abstract search
+std::shared_ptr<PathRoute> HierarchicalPathfinder::search(GridCell start, GridCell goal)
+{
+	if (!isWalkable(start.row, start.col) || !isWalkable(goal.row, goal.col)) return nullptr;
+
+	stats.searches++;
+
+	std::shared_ptr<PathRoute> route = std::make_shared<PathRoute>();
+	route->start = start;
+	route->goal = goal;
+
+	int startCluster = clusterOf(start.row, start.col);
+	int goalCluster = clusterOf(goal.row, goal.col);
+	int top, left, bottom, right;
+
+	// Paths that stay inside one cluster skip the abstract graph
+	if (startCluster == goalCluster) {
+		clusterBounds(startCluster, top, left, bottom, right);
+		searchCells(start, top, left, bottom, right, &goal);
+
+		if (cellStamp[goal.row * width + goal.col] == cellSearch) {
+			route->waypoints = { start, goal };
+			route->waypointClusters = { startCluster, startCluster };
+			return route;
+		}
+	}
+
+	// Temporary nodes linked to every reachable node of their cluster
+	int endpoints[2] = { addNode(start, startCluster), addNode(goal, goalCluster) };
+	for (int endpoint : endpoints) {
+		Node& node = nodes[endpoint];
+		clusterBounds(node.cluster, top, left, bottom, right);
+		searchCells(node.cell, top, left, bottom, right, nullptr);
+
+		std::vector<int> members = clusterNodes[node.cluster];
+		for (int id : members) {
+			if (id == endpoints[0] || id == endpoints[1]) continue;
+
+			GridCell cell = nodes[id].cell;
+			int index = cell.row * width + cell.col;
+			if (cellStamp[index] == cellSearch) connect(endpoint, id, cellCost[index]);
+		}
+	}
+
+	nodeCost.resize(nodes.size());
+	nodeParent.resize(nodes.size());
+	nodeStamp.resize(nodes.size(), 0);
+	nodeSearch++;
+
+	using Item = std::pair<int, int>;
+	std::priority_queue<Item, std::vector<Item>, std::greater<Item>> open;
+	nodeStamp[endpoints[0]] = nodeSearch;
+	nodeCost[endpoints[0]] = 0;
+	nodeParent[endpoints[0]] = -1;
+	open.push({ octile(start, goal), endpoints[0] });
+
+	bool found = false;
+	while (!open.empty()) {
+		auto [priority, current] = open.top();
+		open.pop();
+
+		int cost = nodeCost[current];
+		if (priority - octile(nodes[current].cell, goal) > cost) continue;
+		if (current == endpoints[1]) {
+			found = true;
+			break;
+		}
+
+		for (const Edge& edge : nodes[current].edges) {
+			int newCost = cost + edge.cost;
+			if (nodeStamp[edge.to] == nodeSearch && nodeCost[edge.to] <= newCost) continue;
+
+			nodeStamp[edge.to] = nodeSearch;
+			nodeCost[edge.to] = newCost;
+			nodeParent[edge.to] = current;
+			open.push({ newCost + octile(nodes[edge.to].cell, goal), edge.to });
+		}
+	}
+
+	if (found) {
+		for (int id = endpoints[1]; id != -1; id = nodeParent[id]) {
+			route->waypoints.push_back(nodes[id].cell);
+			route->waypointClusters.push_back(nodes[id].cluster);
+		}
+
+		std::reverse(route->waypoints.begin(), route->waypoints.end());
+		std::reverse(route->waypointClusters.begin(), route->waypointClusters.end());
+	}
+
+	removeNode(endpoints[1]);
+	removeNode(endpoints[0]);
+
+	return found ? route : nullptr;
+}
+
+std::shared_ptr<PathRoute> HierarchicalPathfinder::findPath(GridCell start, GridCell goal)
+{
+	applyDirtyClusters();
+
+	uint64_t key = cacheKey(start, goal);
+	auto it = cache.find(key);
+	if (it != cache.end() && it->second.route->valid) {
+		it->second.lastUse = ++cacheClock;
+		stats.cacheHits++;
+		return it->second.route;
+	}
+
+	std::shared_ptr<PathRoute> route = search(start, goal);
+	if (!route) return nullptr;
+
+	if (cache.size() >= MAX_CACHED_PATHS) {
+		auto oldest = std::min_element(cache.begin(), cache.end(), [](auto& a, auto& b) {
+			return a.second.lastUse < b.second.lastUse;
+		});
+		cache.erase(oldest);
+	}
+
+	cache[key] = { route, ++cacheClock };
+	return route;
+}
+
+void HierarchicalPathfinder::refine(PathRoute& route, int segments)
+{
+	if (route.cells.empty() && !route.waypoints.empty()) route.cells.push_back(route.start);
+
+	while (!route.isRefined() && segments != 0) {
+		int i = route.refinedSegments;
+		GridCell from = route.waypoints[i];
+		GridCell to = route.waypoints[i + 1];
+
+		if (from == to) {
+			// Duplicate node where two borders meet
+		}
+		else if (route.waypointClusters[i] == route.waypointClusters[i + 1]) {
+			int top, left, bottom, right;
+			clusterBounds(route.waypointClusters[i], top, left, bottom, right);
+			searchCells(from, top, left, bottom, right, &to);
+
+			if (!tracePath(from, to, route.cells)) {
+				route.valid = false;
+				return;
+			}
+		}
+		else {
+			// Entrance pairs are neighbouring cells
+			route.cells.push_back(to);
+		}
+
+		route.refinedSegments++;
+		segments--;
+	}
+}
+
+// Requests
+int HierarchicalPathfinder::requestPath(GridCell start, GridCell goal)
+{
+	int id = nextRequest++;
+	requests[id] = { start, goal, PATH_PENDING, nullptr };
+	queue.push_back(id);
+	return id;
+}
+
+PathStatus HierarchicalPathfinder::getStatus(int request) const
+{
+	auto it = requests.find(request);
+	return it != requests.end() ? it->second.status : PATH_NOT_FOUND;
+}
+
+std::shared_ptr<PathRoute> HierarchicalPathfinder::getResult(int request) const
+{
+	auto it = requests.find(request);
+	return it != requests.end() ? it->second.route : nullptr;
+}
+
+void HierarchicalPathfinder::releaseRequest(int request)
+{
+	requests.erase(request);
+}
+
+void HierarchicalPathfinder::serve(Request& request)
+{
+	request.route = findPath(request.start, request.goal);
+	request.status = request.route ? PATH_FOUND : PATH_NOT_FOUND;
+}
+
+void HierarchicalPathfinder::update(double budgetMs)
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+
+	applyDirtyClusters();
+
+	int processed = 0;
+	while (!queue.empty()) {
+		double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		if (elapsed >= budgetMs) break;
+
+		int id = queue.front();
+		queue.pop_front();
+
+		auto it = requests.find(id);
+		if (it == requests.end()) continue;
+
+		serve(it->second);
+		processed++;
+	}
+
+	stats.queued = queue.size();
+	stats.processedLastTick = processed;
+	stats.lastTickMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
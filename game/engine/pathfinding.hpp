@@ -0,0 +1,176 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+#include "world.hpp"
+
+struct GridCell
+{
+	int row;
+	int col;
+
+	inline bool operator==(const GridCell& other) const { return row == other.row && col == other.col; }
+	inline bool operator!=(const GridCell& other) const { return !(*this == other); }
+};
+
+// A path found on the abstract graph. Segments between waypoints are turned
+// into cells only when refine() is asked for them.
+struct PathRoute
+{
+	GridCell start;
+	GridCell goal;
+
+	std::vector<GridCell> waypoints;
+	std::vector<int> waypointClusters;
+
+	std::vector<GridCell> cells;
+	int refinedSegments = 0;
+
+	// Cleared when a tile changes in a cluster the route goes through
+	bool valid = true;
+
+	inline bool isRefined() const { return refinedSegments + 1 >= waypoints.size(); }
+};
+
+enum PathStatus
+{
+	PATH_PENDING,
+	PATH_FOUND,
+	PATH_NOT_FOUND
+};
+
+struct PathfinderStats
+{
+	uint64_t searches = 0;
+	uint64_t cacheHits = 0;
+	uint64_t invalidated = 0;
+	int queued = 0;
+	int processedLastTick = 0;
+	double lastTickMs = 0;
+};
+
+// HPA* over the map navigation grid: the grid is split into square clusters,
+// cluster borders get entrance nodes, and nodes inside a cluster are linked
+// by precomputed distances. Movement is 8-directional without corner cutting.
+class HierarchicalPathfinder
+{
+public:
+	HierarchicalPathfinder(Map* map, int clusterSize = 16);
+
+	inline int getClusterSize() const { return clusterSize; }
+	inline int getNodeCount() const { return nodes.size() - freeNodes.size(); }
+	inline PathfinderStats getStats() const { return stats; }
+
+	inline bool isWalkable(int row, int col) const {
+		return row >= 0 && col >= 0 && row < height && col < width && map->getNavigationMap()[row * width + col] == 0;
+	}
+
+	// Full abstraction build, needed after the map is resized
+	void rebuild();
+	// Call after the navigation map cell at (row, col) changed
+	void notifyTileChanged(int row, int col);
+	// Same for every cell of a rectangle, touching each cluster once
+	void notifyRegionChanged(TileRect rect);
+
+	// Synchronous query, served from the cache when possible
+	std::shared_ptr<PathRoute> findPath(GridCell start, GridCell goal);
+	// Turns the next segments of a route into cells, -1 refines everything
+	void refine(PathRoute& route, int segments = -1);
+
+	// Time-sliced queue, processed by update()
+	int requestPath(GridCell start, GridCell goal);
+	PathStatus getStatus(int request) const;
+	std::shared_ptr<PathRoute> getResult(int request) const;
+	void releaseRequest(int request);
+
+	// Applies pending tile changes, then serves queued requests until the budget runs out
+	void update(double budgetMs);
+
+private:
+	struct Edge
+	{
+		int to;
+		int cost;
+	};
+
+	struct Node
+	{
+		GridCell cell;
+		int cluster;
+		bool active = false;
+		std::vector<Edge> edges;
+	};
+
+	struct CacheEntry
+	{
+		std::shared_ptr<PathRoute> route;
+		uint64_t lastUse;
+	};
+
+	struct Request
+	{
+		GridCell start;
+		GridCell goal;
+		PathStatus status;
+		std::shared_ptr<PathRoute> route;
+	};
+
+	Map* map;
+	int width = 0;
+	int height = 0;
+	int clusterSize;
+	int clusterColumns = 0;
+	int clusterRows = 0;
+
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+	std::vector<std::vector<int>> clusterNodes;
+	// Entrance nodes of the border to the right (index * 2) and below (index * 2 + 1)
+	std::vector<std::vector<int>> borderNodes;
+	std::vector<uint8_t> dirtyClusters;
+	bool hasDirtyClusters = false;
+
+	// Search scratch, reset by bumping the stamp
+	std::vector<int> cellCost;
+	std::vector<int> cellParent;
+	std::vector<uint32_t> cellStamp;
+	uint32_t cellSearch = 0;
+
+	std::vector<int> nodeCost;
+	std::vector<int> nodeParent;
+	std::vector<uint32_t> nodeStamp;
+	uint32_t nodeSearch = 0;
+
+	std::unordered_map<uint64_t, CacheEntry> cache;
+	uint64_t cacheClock = 0;
+
+	std::unordered_map<int, Request> requests;
+	std::deque<int> queue;
+	int nextRequest = 0;
+
+	PathfinderStats stats;
+
+	inline int clusterOf(int row, int col) const { return (row / clusterSize) * clusterColumns + col / clusterSize; }
+	inline static uint64_t cacheKey(GridCell start, GridCell goal) {
+		return (uint64_t)(uint16_t)start.row << 48 | (uint64_t)(uint16_t)start.col << 32
+			| (uint64_t)(uint16_t)goal.row << 16 | (uint16_t)goal.col;
+	}
+
+	int addNode(GridCell cell, int cluster);
+	void removeNode(int id);
+	void connect(int a, int b, int cost);
+
+	void buildBorder(int cluster, int direction);
+	void buildIntraEdges(int cluster);
+	void applyDirtyClusters();
+	void invalidateCluster(int cluster);
+
+	void clusterBounds(int cluster, int& top, int& left, int& bottom, int& right) const;
+	void searchCells(GridCell start, int top, int left, int bottom, int right, const GridCell* goal);
+	bool tracePath(GridCell start, GridCell goal, std::vector<GridCell>& out);
+
+	std::shared_ptr<PathRoute> search(GridCell start, GridCell goal);
+	void serve(Request& request);
+};
@@ -0,0 +1,137 @@
+#include "render.hpp"
+#include <algorithm>
+
+void RenderSnapshotBuilder::capture(Map* map, const Camera2D& camera, uint64_t tick, RenderSnapshot& out)
+{
+	out.tick = tick;
+	out.camera = camera;
+	out.sprites.clear();
+
+	if (map == nullptr) {
+		out.layers.clear();
+		return;
+	}
+
+	std::vector<std::shared_ptr<TilemapLayer>>& layers = map->getMapLayers();
+	caches.resize(layers.size());
+	out.layers.resize(layers.size());
+
+	for (int i = 0; i < layers.size(); i++) {
+		captureLayer(layers[i].get(), caches[i], out.layers[i]);
+	}
+
+	for (std::shared_ptr<Sprite> item : map->getSprites()) {
+		Sprite* sprite = item.get();
+		AnimationPlayer* player = sprite->getAnimationPlayer();
+		if (player == nullptr) continue;
+
+		Rectangle source = player->getSource();
+
+		SpriteSnapshot spriteSnapshot;
+		spriteSnapshot.texture = player->getTexture();
+		spriteSnapshot.source = source;
+		spriteSnapshot.position = sprite->getRoundedPosition();
+		spriteSnapshot.scale = sprite->getScale();
+		spriteSnapshot.origin = sprite->isCentered()
+			? Vector2{ source.width / 2 + sprite->getOrigin().x, source.height / 2 + sprite->getOrigin().y }
+			: sprite->getOrigin();
+		spriteSnapshot.flipX = sprite->getFlipX();
+		spriteSnapshot.flipY = sprite->getFlipY();
+
+		out.sprites.push_back(spriteSnapshot);
+	}
+}
+
+void RenderSnapshotBuilder::captureLayer(TilemapLayer* layer, LayerCache& cache, LayerSnapshot& out)
+{
+	Tileset* tileset = layer->getTileset();
+
+	out.dirtyChunks.clear();
+	out.texture = tileset->getTexture();
+	out.cellSize = layer->getCellSize();
+
+	// Source rects only change when tiles animate
+	if (cache.tileset != tileset || cache.sourcesVersion != tileset->getSourcesVersion() || !cache.sources) {
+		cache.tileset = tileset;
+		cache.sourcesVersion = tileset->getSourcesVersion();
+		cache.sources = std::make_shared<const std::vector<Rectangle>>(
+			tileset->getTileSources(), tileset->getTileSources() + tileset->getTileCount() + 1);
+	}
+	out.sources = cache.sources;
+
+	out.width = layer->getWidth();
+	out.height = layer->getHeight();
+	out.chunkColumns = layer->getChunkColumns();
+
+	cache.chunks.sync(layer, &out.dirtyChunks);
+	out.chunks = cache.chunks.getChunks();
+}
+
+void SnapshotRenderer::draw(const RenderSnapshot& snapshot, int viewportWidth, int viewportHeight)
+{
+	BeginMode2D(snapshot.camera);
+
+	for (const LayerSnapshot& layer : snapshot.layers) {
+		drawLayer(layer, snapshot.camera, viewportWidth, viewportHeight);
+	}
+
+	for (const SpriteSnapshot& sprite : snapshot.sprites) {
+		Rectangle source = sprite.source;
+		if (sprite.flipX) source.width = -source.width;
+		if (sprite.flipY) source.height = -source.height;
+
+		DrawTexturePro(
+			sprite.texture,
+			source,
+			{
+				sprite.position.x,
+				sprite.position.y,
+				sprite.source.width * sprite.scale.x,
+				sprite.source.height * sprite.scale.y
+			},
+			sprite.origin,
+			0,
+			WHITE
+		);
+	}
+
+	EndMode2D();
+}
+
+void SnapshotRenderer::drawLayer(const LayerSnapshot& layer, const Camera2D& camera, int viewportWidth, int viewportHeight)
+{
+	if (layer.chunks.empty() || !layer.sources) return;
+
+	int cellSize = layer.cellSize;
+	int startCol = (camera.target.x - camera.offset.x) / cellSize;
+	int endCol = (camera.target.x - camera.offset.x + viewportWidth + cellSize) / cellSize;
+	int startRow = (camera.target.y - camera.offset.y) / cellSize;
+	int endRow = (camera.target.y - camera.offset.y + viewportHeight + cellSize) / cellSize;
+
+	startCol = std::clamp(startCol, 0, layer.width - 1);
+	endCol = std::clamp(endCol, 0, layer.width - 1);
+	startRow = std::clamp(startRow, 0, layer.height - 1);
+	endRow = std::clamp(endRow, 0, layer.height - 1);
+
+	const Rectangle* sources = layer.sources->data();
+
+	for (int i = startRow; i < endRow; i++)
+	{
+		int chunkRow = i / TILE_CHUNK_SIZE;
+		int localRow = i % TILE_CHUNK_SIZE;
+
+		for (int j = startCol; j < endCol; j++)
+		{
+			const TileChunk* chunk = layer.chunks[chunkRow * layer.chunkColumns + j / TILE_CHUNK_SIZE].get();
+			int id = chunk->tiles[localRow * TILE_CHUNK_SIZE + j % TILE_CHUNK_SIZE];
+			if (id <= 0) continue;
+
+			DrawTextureRec(
+				layer.texture,
+				sources[id],
+				{ (float)cellSize * j, (float)cellSize * i },
+				WHITE
+			);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "gfx.hpp"
+#include "world.hpp"
+
+struct LayerSnapshot
+{
+	Texture2D texture;
+	int width = 0;
+	int height = 0;
+	int cellSize = 0;
+	int chunkColumns = 0;
+
+	std::shared_ptr<const std::vector<Rectangle>> sources;
+	std::vector<std::shared_ptr<const TileChunk>> chunks;
+	// Chunks copied for this snapshot because the layer changed
+	std::vector<int> dirtyChunks;
+};
+
+struct SpriteSnapshot
+{
+	Texture2D texture;
+	Rectangle source;
+	Vector2 position;
+	Vector2 scale;
+	Vector2 origin;
+	bool flipX;
+	bool flipY;
+};
+
+// Everything the render thread needs for one frame
+struct RenderSnapshot
+{
+	uint64_t tick = 0;
+	Camera2D camera = { 0 };
+
+	std::vector<LayerSnapshot> layers;
+	std::vector<SpriteSnapshot> sprites;
+};
+
+// Runs on the simulation thread. Keeps the last published chunks so only
+// chunks whose version changed get copied.
+class RenderSnapshotBuilder
+{
+public:
+	void capture(Map* map, const Camera2D& camera, uint64_t tick, RenderSnapshot& out);
+
+private:
+	struct LayerCache
+	{
+		// Unchanged chunks are shared between consecutive snapshots
+		TileChunkCache chunks;
+
+		Tileset* tileset = nullptr;
+		uint32_t sourcesVersion = 0;
+		std::shared_ptr<const std::vector<Rectangle>> sources;
+	};
+
+	std::vector<LayerCache> caches;
+
+	void captureLayer(TilemapLayer* layer, LayerCache& cache, LayerSnapshot& out);
+};
+
+// Runs on the render thread, the only one touching the GL context
+class SnapshotRenderer
+{
+public:
+	void draw(const RenderSnapshot& snapshot, int viewportWidth, int viewportHeight);
+
+private:
+	void drawLayer(const LayerSnapshot& layer, const Camera2D& camera, int viewportWidth, int viewportHeight);
+};
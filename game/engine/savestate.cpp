@@ -0,0 +1,491 @@
+#include "savestate.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Rejects corrupt layer sizes before allocating
+#define MAX_LAYER_SIDE 16384
+
+// Binary helpers
+static void writeVarint(std::vector<uint8_t>& out, uint64_t value)
+{
+	while (value >= 0x80) {
+		out.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((uint8_t)value);
+}
+
+static void writeSigned(std::vector<uint8_t>& out, int64_t value)
+{
+	writeVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+static void writeFloat(std::vector<uint8_t>& out, float value)
+{
+	uint8_t bytes[sizeof(float)];
+	std::memcpy(bytes, &value, sizeof(float));
+	out.insert(out.end(), bytes, bytes + sizeof(float));
+}
+
+static void writeVector(std::vector<uint8_t>& out, Vector2 value)
+{
+	writeFloat(out, value.x);
+	writeFloat(out, value.y);
+}
+
+struct BinaryReader
+{
+	const uint8_t* data;
+	size_t size;
+	size_t position = 0;
+	bool ok = true;
+
+	uint64_t readVarint() {
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7) {
+			if (position >= size) {
+				ok = false;
+				return 0;
+			}
+
+			uint8_t byte = data[position++];
+			value |= (uint64_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80)) return value;
+		}
+
+		ok = false;
+		return 0;
+	}
+
+	int64_t readSigned() {
+		uint64_t value = readVarint();
+		return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+	}
+
+	float readFloat() {
+		float value = 0;
+		if (position + sizeof(float) > size) {
+			ok = false;
+			return value;
+		}
+
+		std::memcpy(&value, data + position, sizeof(float));
+		position += sizeof(float);
+		return value;
+	}
+
+	Vector2 readVector() {
+		float x = readFloat();
+		float y = readFloat();
+		return { x, y };
+	}
+
+	// Layer or map side, compared before narrowing so huge values can't wrap negative
+	int readSide() {
+		uint64_t value = readVarint();
+		if (value == 0 || value > MAX_LAYER_SIDE) {
+			ok = false;
+			return 0;
+		}
+		return (int)value;
+	}
+
+	// Element count that can't claim more than the remaining bytes
+	size_t readCount(size_t minBytesEach) {
+		uint64_t count = readVarint();
+		if (count > (size - position) / minBytesEach) {
+			ok = false;
+			return 0;
+		}
+		return count;
+	}
+
+	bool readBytes(void* out, size_t count) {
+		if (position + count > size) {
+			ok = false;
+			return false;
+		}
+
+		if (count > 0) std::memcpy(out, data + position, count);
+		position += count;
+		return true;
+	}
+};
+
+static inline int chunkTile(const LayerState& layer, int row, int col)
+{
+	int chunkColumns = (layer.width + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+	const TileChunk* chunk = layer.chunks[(row / TILE_CHUNK_SIZE) * chunkColumns + col / TILE_CHUNK_SIZE].get();
+	return chunk->tiles[(row % TILE_CHUNK_SIZE) * TILE_CHUNK_SIZE + col % TILE_CHUNK_SIZE];
+}
+
+// Snapshot manager
+SnapshotManager::SnapshotManager(int capacity)
+{
+	ring.resize(std::max(capacity, 1));
+}
+
+void SnapshotManager::capture(Map* map, const Camera2D& camera, uint64_t tick, GameSnapshot& out)
+{
+	out.tick = tick;
+	out.camera = camera;
+	out.sprites.clear();
+	out.userData.clear();
+
+	if (map == nullptr) {
+		out.layers.clear();
+		out.navigation = nullptr;
+		return;
+	}
+
+	std::vector<std::shared_ptr<TilemapLayer>>& layers = map->getMapLayers();
+	caches.resize(layers.size());
+	out.layers.resize(layers.size());
+
+	for (int i = 0; i < layers.size(); i++) {
+		caches[i].sync(layers[i].get());
+
+		out.layers[i].width = caches[i].getWidth();
+		out.layers[i].height = caches[i].getHeight();
+		out.layers[i].chunks = caches[i].getChunks();
+	}
+
+	// Navigation is packed to bits and shared while it doesn't change
+	std::vector<int>& navigationMap = map->getNavigationMap();
+	out.navigationWidth = map->getWidth();
+	out.navigationHeight = map->getHeight();
+
+	bool navigationUnchanged = lastNavigation && lastMap == map && lastNavigationVersion == map->getNavigationVersion()
+		&& lastNavigation->size() == (navigationMap.size() + 63) / 64;
+
+	if (navigationUnchanged) {
+		out.navigation = lastNavigation;
+	}
+	else if (navigationMap.size() == map->getWidth() * map->getHeight()) {
+		lastMap = map;
+		lastNavigationVersion = map->getNavigationVersion();
+
+		navigationScratch.assign((navigationMap.size() + 63) / 64, 0);
+		for (int i = 0; i < navigationMap.size(); i++) {
+			navigationScratch[i >> 6] |= (uint64_t)(navigationMap[i] == 1) << (i & 63);
+		}
+
+		if (!lastNavigation || *lastNavigation != navigationScratch) {
+			lastNavigation = std::make_shared<const std::vector<uint64_t>>(navigationScratch);
+		}
+		out.navigation = lastNavigation;
+	}
+	else {
+		out.navigation = nullptr;
+	}
+
+	for (std::shared_ptr<Sprite> sprite : map->getSprites()) {
+		SpriteState state;
+		state.sprite = sprite;
+		state.pool = sprite->getPool();
+		state.poolSlot = sprite->getPoolSlot();
+		state.position = sprite->getPosition();
+		state.scale = sprite->getScale();
+		state.origin = sprite->getOrigin();
+		state.centered = sprite->isCentered();
+		state.flipX = sprite->getFlipX();
+		state.flipY = sprite->getFlipY();
+
+		AnimationPlayer* player = sprite->getAnimationPlayer();
+		state.animation = player ? player->getCurrentAnimationName() : "";
+		state.frameIndex = player ? player->getCurrentFrameIndex() : 0;
+		state.timer = player ? player->getTimer() : 0;
+		state.playing = player ? player->isPlaying() : false;
+
+		out.sprites.push_back(state);
+	}
+}
+
+void SnapshotManager::restore(Map* map, const GameSnapshot& snapshot, Camera2D& camera, uint64_t& tick)
+{
+	camera = snapshot.camera;
+	tick = snapshot.tick;
+
+	if (map == nullptr) return;
+
+	if (map->getWidth() != snapshot.navigationWidth) map->setWidth(snapshot.navigationWidth);
+	if (map->getHeight() != snapshot.navigationHeight) map->setHeight(snapshot.navigationHeight);
+
+	std::vector<std::shared_ptr<TilemapLayer>>& layers = map->getMapLayers();
+	int layerCount = std::min(layers.size(), snapshot.layers.size());
+	caches.resize(layers.size());
+
+	for (int i = 0; i < layerCount; i++) {
+		const LayerState& layer = snapshot.layers[i];
+		caches[i].restore(layers[i].get(), layer.width, layer.height, layer.chunks);
+	}
+
+	size_t navigationCells = (size_t)snapshot.navigationWidth * snapshot.navigationHeight;
+	bool navigationValid = snapshot.navigation && snapshot.navigation->size() == (navigationCells + 63) / 64;
+	if (snapshot.navigation && !navigationValid) {
+		TraceLog(LOG_WARNING, "SNAPSHOT: Navigation bits don't match the map size, regenerating them");
+	}
+
+	if (navigationValid) {
+		std::vector<int>& navigationMap = map->getNavigationMap();
+		const std::vector<uint64_t>& bits = *snapshot.navigation;
+
+		navigationMap.resize(snapshot.navigationWidth * snapshot.navigationHeight);
+		for (int i = 0; i < navigationMap.size(); i++) {
+			navigationMap[i] = (bits[i >> 6] >> (i & 63)) & 1;
+		}
+
+		map->touchNavigationMap();
+		lastMap = map;
+		lastNavigationVersion = map->getNavigationVersion();
+		lastNavigation = snapshot.navigation;
+	}
+	else {
+		map->generateNavigationMap();
+	}
+
+	// The sprite list is rebuilt to match the snapshot, an empty one clears the map.
+	// Deserialized snapshots have no pointers: pooled sprites come back from the
+	// sprite source, the others reuse the current sprite at the same index.
+	std::vector<std::shared_ptr<Sprite>>& sprites = map->getSprites();
+	std::vector<std::shared_ptr<Sprite>> previous = sprites;
+	sprites.clear();
+
+	int missing = 0;
+	for (int i = 0; i < snapshot.sprites.size(); i++) {
+		const SpriteState& state = snapshot.sprites[i];
+
+		std::shared_ptr<Sprite> found = state.sprite;
+		if (found == nullptr && state.pool >= 0) {
+			if (spriteSource) found = spriteSource->findSprite(state.pool, state.poolSlot);
+		}
+		else if (found == nullptr && i < previous.size() && previous[i]->getPool() < 0) {
+			found = previous[i];
+		}
+
+		if (found == nullptr) {
+			missing++;
+			continue;
+		}
+		sprites.push_back(found);
+		Sprite* sprite = found.get();
+
+		sprite->setPosition(state.position);
+		sprite->setScale(state.scale);
+		sprite->setOrigin(state.origin);
+		sprite->setCentered(state.centered);
+		sprite->setFlipX(state.flipX);
+		sprite->setFlipY(state.flipY);
+
+		AnimationPlayer* player = sprite->getAnimationPlayer();
+		if (player) player->setPlaybackState(state.animation, state.frameIndex, state.timer, state.playing);
+	}
+
+	if (missing > 0) {
+		TraceLog(LOG_WARNING, ("SNAPSHOT: " + std::to_string(missing) + " sprites of the snapshot could not be found").c_str());
+	}
+}
+
+GameSnapshot& SnapshotManager::record(Map* map, const Camera2D& camera, uint64_t tick)
+{
+	GameSnapshot& snapshot = ring[head];
+	capture(map, camera, tick, snapshot);
+
+	head = (head + 1) % ring.size();
+	count = std::min(count + 1, (int)ring.size());
+	return snapshot;
+}
+
+const GameSnapshot* SnapshotManager::getRecorded(int ticksAgo) const
+{
+	if (ticksAgo < 0 || ticksAgo >= count) return nullptr;
+
+	int index = (head - 1 - ticksAgo + 2 * (int)ring.size()) % ring.size();
+	return &ring[index];
+}
+
+bool SnapshotManager::rollback(Map* map, int ticksAgo, Camera2D& camera, uint64_t& tick)
+{
+	const GameSnapshot* snapshot = getRecorded(ticksAgo);
+	if (snapshot == nullptr) return false;
+
+	restore(map, *snapshot, camera, tick);
+
+	// The restored snapshot becomes the latest one
+	head = (head - ticksAgo + ring.size()) % ring.size();
+	count -= ticksAgo;
+	return true;
+}
+
+void SnapshotManager::clear()
+{
+	for (GameSnapshot& snapshot : ring) snapshot = GameSnapshot();
+	head = 0;
+	count = 0;
+}
+
+// Serialization
+void SnapshotManager::serialize(const GameSnapshot& snapshot, std::vector<uint8_t>& out)
+{
+	out.clear();
+
+	uint32_t magic = SAVESTATE_MAGIC;
+	for (int i = 0; i < sizeof(magic); i++) out.push_back((uint8_t)(magic >> (i * 8)));
+	writeVarint(out, SAVESTATE_VERSION);
+	writeVarint(out, snapshot.tick);
+
+	writeVector(out, snapshot.camera.offset);
+	writeVector(out, snapshot.camera.target);
+	writeFloat(out, snapshot.camera.rotation);
+	writeFloat(out, snapshot.camera.zoom);
+
+	// Layouts as run-length encoded (count, id) pairs
+	writeVarint(out, snapshot.layers.size());
+	for (const LayerState& layer : snapshot.layers) {
+		writeVarint(out, layer.width);
+		writeVarint(out, layer.height);
+
+		int cells = layer.width * layer.height;
+		int i = 0;
+		while (i < cells) {
+			int id = chunkTile(layer, i / layer.width, i % layer.width);
+			int run = 1;
+			while (i + run < cells && chunkTile(layer, (i + run) / layer.width, (i + run) % layer.width) == id) run++;
+
+			writeVarint(out, run);
+			writeSigned(out, id);
+			i += run;
+		}
+	}
+
+	writeVarint(out, snapshot.navigationWidth);
+	writeVarint(out, snapshot.navigationHeight);
+	writeVarint(out, snapshot.navigation ? snapshot.navigation->size() : 0);
+	if (snapshot.navigation) {
+		const uint8_t* bytes = (const uint8_t*)snapshot.navigation->data();
+		out.insert(out.end(), bytes, bytes + snapshot.navigation->size() * sizeof(uint64_t));
+	}
+
+	writeVarint(out, snapshot.sprites.size());
+	for (const SpriteState& state : snapshot.sprites) {
+		writeSigned(out, state.pool);
+		writeSigned(out, state.poolSlot);
+		writeVector(out, state.position);
+		writeVector(out, state.scale);
+		writeVector(out, state.origin);
+		out.push_back(state.centered | state.flipX << 1 | state.flipY << 2 | state.playing << 3);
+
+		writeVarint(out, state.animation.size());
+		out.insert(out.end(), state.animation.begin(), state.animation.end());
+		writeVarint(out, state.frameIndex);
+		writeFloat(out, state.timer);
+	}
+
+	writeVarint(out, snapshot.userData.size());
+	out.insert(out.end(), snapshot.userData.begin(), snapshot.userData.end());
+}
+
+bool SnapshotManager::deserialize(const std::vector<uint8_t>& data, GameSnapshot& out)
+{
+	BinaryReader reader = { data.data(), data.size() };
+
+	uint8_t magicBytes[4];
+	if (!reader.readBytes(magicBytes, sizeof(magicBytes))) return false;
+
+	uint32_t magic = magicBytes[0] | magicBytes[1] << 8 | magicBytes[2] << 16 | (uint32_t)magicBytes[3] << 24;
+	if (magic != SAVESTATE_MAGIC) return false;
+	if (reader.readVarint() != SAVESTATE_VERSION) return false;
+
+	out = GameSnapshot();
+	out.tick = reader.readVarint();
+	out.camera.offset = reader.readVector();
+	out.camera.target = reader.readVector();
+	out.camera.rotation = reader.readFloat();
+	out.camera.zoom = reader.readFloat();
+
+	std::vector<int> layout;
+	out.layers.resize(reader.readCount(2));
+	for (LayerState& layer : out.layers) {
+		layer.width = reader.readSide();
+		layer.height = reader.readSide();
+		if (!reader.ok) return false;
+
+		int cells = layer.width * layer.height;
+		layout.assign(cells, 0);
+		for (int i = 0; i < cells;) {
+			uint64_t run = reader.readVarint();
+			int id = reader.readSigned();
+			if (!reader.ok || run == 0 || run > (uint64_t)(cells - i)) return false;
+
+			std::fill_n(layout.begin() + i, run, id);
+			i += run;
+		}
+
+		int chunkColumns = (layer.width + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+		int chunkRows = (layer.height + TILE_CHUNK_SIZE - 1) / TILE_CHUNK_SIZE;
+		for (int chunkRow = 0; chunkRow < chunkRows; chunkRow++) {
+			for (int chunkCol = 0; chunkCol < chunkColumns; chunkCol++) {
+				std::shared_ptr<TileChunk> chunk = std::make_shared<TileChunk>();
+
+				int startRow = chunkRow * TILE_CHUNK_SIZE;
+				int startCol = chunkCol * TILE_CHUNK_SIZE;
+				int rows = std::min(TILE_CHUNK_SIZE, layer.height - startRow);
+				int cols = std::min(TILE_CHUNK_SIZE, layer.width - startCol);
+
+				for (int i = 0; i < rows; i++) {
+					std::copy_n(&layout[(startRow + i) * layer.width + startCol], cols, &chunk->tiles[i * TILE_CHUNK_SIZE]);
+				}
+
+				layer.chunks.push_back(chunk);
+			}
+		}
+	}
+
+	out.navigationWidth = reader.readSide();
+	out.navigationHeight = reader.readSide();
+	if (!reader.ok) return false;
+	for (const LayerState& layer : out.layers) {
+		if (layer.width != out.navigationWidth || layer.height != out.navigationHeight) return false;
+	}
+
+	// Either no navigation block or exactly one bit per cell
+	size_t words = reader.readCount(sizeof(uint64_t));
+	size_t expectedWords = ((size_t)out.navigationWidth * out.navigationHeight + 63) / 64;
+	if (!reader.ok || (words != 0 && words != expectedWords)) return false;
+
+	if (words > 0) {
+		std::vector<uint64_t> bits(words);
+		if (!reader.readBytes(bits.data(), words * sizeof(uint64_t))) return false;
+		out.navigation = std::make_shared<const std::vector<uint64_t>>(std::move(bits));
+	}
+
+	out.sprites.resize(reader.readCount(32));
+	for (SpriteState& state : out.sprites) {
+		int64_t pool = reader.readSigned();
+		int64_t poolSlot = reader.readSigned();
+		if (!reader.ok || pool < -1 || pool > INT32_MAX || poolSlot < -1 || poolSlot > INT32_MAX) return false;
+		state.pool = pool;
+		state.poolSlot = poolSlot;
+
+		state.position = reader.readVector();
+		state.scale = reader.readVector();
+		state.origin = reader.readVector();
+
+		uint8_t flags = 0;
+		reader.readBytes(&flags, 1);
+		state.centered = flags & 1;
+		state.flipX = flags & 2;
+		state.flipY = flags & 4;
+		state.playing = flags & 8;
+
+		state.animation.resize(reader.readCount(1));
+		if (!reader.ok || !reader.readBytes(state.animation.data(), state.animation.size())) return false;
+		state.frameIndex = reader.readVarint();
+		state.timer = reader.readFloat();
+	}
+
+	out.userData.resize(reader.readCount(1));
+	if (!reader.ok || !reader.readBytes(out.userData.data(), out.userData.size())) return false;
+
+	return reader.ok;
+}
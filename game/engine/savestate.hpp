@@ -0,0 +1,107 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include "gfx.hpp"
+#include "world.hpp"
+
+#define SAVESTATE_MAGIC 0x53534447
+#define SAVESTATE_VERSION 2
+
+struct LayerState
+{
+	int width = 0;
+	int height = 0;
+	std::vector<std::shared_ptr<const TileChunk>> chunks;
+};
+
+struct SpriteState
+{
+	// Null after deserializing, sprites are then found by pool and slot
+	std::shared_ptr<Sprite> sprite;
+	int pool = -1;
+	int poolSlot = -1;
+
+	Vector2 position;
+	Vector2 scale;
+	Vector2 origin;
+	bool centered;
+	bool flipX;
+	bool flipY;
+
+	std::string animation;
+	int frameIndex;
+	float timer;
+	bool playing;
+};
+
+// Full simulation state at one tick. Tile chunks and the navigation bits are
+// immutable and shared with other snapshots whenever they didn't change.
+struct GameSnapshot
+{
+	uint64_t tick = 0;
+	Camera2D camera = { 0 };
+
+	int navigationWidth = 0;
+	int navigationHeight = 0;
+	// One bit per cell, set for solid cells
+	std::shared_ptr<const std::vector<uint64_t>> navigation;
+
+	std::vector<LayerState> layers;
+	std::vector<SpriteState> sprites;
+
+	// Game specific state, opaque to the engine
+	std::vector<uint8_t> userData;
+};
+
+// Hands out pooled sprites by pool and slot, so a deserialized snapshot can
+// rebuild the sprite list
+class SpriteSource
+{
+public:
+	virtual ~SpriteSource() {}
+
+	// nullptr when there is no such sprite
+	virtual std::shared_ptr<Sprite> findSprite(int pool, int slot) = 0;
+};
+
+// Records snapshots into a fixed ring for rollback, and converts them to a
+// compact binary blob for quick saves
+class SnapshotManager
+{
+public:
+	SnapshotManager(int capacity = 120);
+
+	inline int getCapacity() const { return ring.size(); }
+	inline int getCount() const { return count; }
+	inline void setSpriteSource(SpriteSource* spriteSource) { this->spriteSource = spriteSource; }
+
+	void capture(Map* map, const Camera2D& camera, uint64_t tick, GameSnapshot& out);
+	void restore(Map* map, const GameSnapshot& snapshot, Camera2D& camera, uint64_t& tick);
+
+	// Captures into the next ring slot, overwriting the oldest one when full
+	GameSnapshot& record(Map* map, const Camera2D& camera, uint64_t tick);
+	// 0 is the latest recorded snapshot, nullptr when not that far back
+	const GameSnapshot* getRecorded(int ticksAgo) const;
+	// Restores an older snapshot and forgets everything recorded after it
+	bool rollback(Map* map, int ticksAgo, Camera2D& camera, uint64_t& tick);
+	void clear();
+
+	static void serialize(const GameSnapshot& snapshot, std::vector<uint8_t>& out);
+	// False when the data is truncated or not a snapshot
+	static bool deserialize(const std::vector<uint8_t>& data, GameSnapshot& out);
+
+private:
+	SpriteSource* spriteSource = nullptr;
+	std::vector<TileChunkCache> caches;
+	Map* lastMap = nullptr;
+	uint32_t lastNavigationVersion = 0;
+	std::shared_ptr<const std::vector<uint64_t>> lastNavigation;
+	std::vector<uint64_t> navigationScratch;
+
+	std::vector<GameSnapshot> ring;
+	int head = 0;
+	int count = 0;
+};
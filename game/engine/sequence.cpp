@@ -1,5 +1,6 @@
 #include "sequence.hpp"
 #include <fstream>
+#include <algorithm>
 #include <iostream>
 #include "utils.hpp"
 #include "gfx.hpp"
@@ -45,12 +46,12 @@ AnimationPlayer::AnimationPlayer(std::string animFile)
 	case ORDINAR:
 	{
 		this->texturePath = textureDir + (std::string)jsonData["texture"];
-		this->texture = AssetManager::loadTexture(this->texturePath);
+		this->texture = AssetManager::acquireTexture(this->texturePath);
 
 		int regionWidth = jsonData["width"];
 		int regionHeight = jsonData["height"];
 
-		TextureAtlas atlas(this->texture.width, this->texture.height, regionWidth, regionHeight);
+		TextureAtlas atlas(this->texture.get().width, this->texture.get().height, regionWidth, regionHeight);
 		atlas.createGrid();
 
 		for (auto& anim : jsonData["animations"].items()) {
@@ -79,7 +80,7 @@ AnimationPlayer::AnimationPlayer(std::string animFile)
 	{
 		// Load a texture
 		this->texturePath = textureDir + (std::string)jsonData["meta"]["image"];
-		this->texture = AssetManager::loadTexture(this->texturePath);
+		this->texture = AssetManager::acquireTexture(this->texturePath);
 
 		// Adding aseprite animations
 		nlohmann::ordered_json tags = jsonData["meta"]["frameTags"];
@@ -135,6 +136,33 @@ AnimationPlayer::AnimationPlayer(std::string animFile)
 	}
 }
 
+AnimationPlayer::~AnimationPlayer()
+{
+	for (auto& animation : animations) {
+		delete animation.second;
+	}
+}
+
+AnimationPlayer* AnimationPlayer::clone() const
+{
+	AnimationPlayer* copy = new AnimationPlayer();
+	copy->animFile = animFile;
+	copy->texturePath = texturePath;
+	copy->type = type;
+	copy->texture = TextureHandle(texture.get());
+
+	// getCurrentAnimation() may have left null entries behind
+	for (auto& animation : animations) {
+		copy->animations[animation.first] = animation.second ? new Animation(*animation.second) : nullptr;
+	}
+
+	copy->playing = playing;
+	copy->timer = timer;
+	copy->currentAnimationName = currentAnimationName;
+	copy->currentFrameIndex = currentFrameIndex;
+	return copy;
+}
+
 void AnimationPlayer::play(std::string name, bool repeat)
 {
 	if (getCurrentAnimation() != nullptr && getCurrentAnimation()->getName() == name) return;
@@ -153,13 +181,31 @@ void AnimationPlayer::stop()
 	timer = 0;
 }
 
+void AnimationPlayer::setPlaybackState(std::string name, int frameIndex, float timer, bool playing)
+{
+	if (!name.empty() && !animations.contains(name)) return;
+
+	// The state may come from another sprite or a corrupt save, keep the frame in range
+	Animation* animation = name.empty() ? nullptr : animations[name];
+	int frameCount = animation ? animation->getFrameCount() : 0;
+	this->currentAnimationName = name;
+	this->currentFrameIndex = std::clamp(frameIndex, 0, std::max(frameCount - 1, 0));
+	this->timer = timer;
+	this->playing = playing;
+}
+
 void AnimationPlayer::update()
+{
+	update(GetFrameTime());
+}
+
+void AnimationPlayer::update(float delta)
 {
 	if (getCurrentAnimation() == nullptr || !playing) {
 		return;
 	}
 
-	timer += GetFrameTime();
+	timer += delta;
 	if (timer >= getCurrentFrame().delay) {
 		timer = 0;
 
@@ -171,7 +217,7 @@ void AnimationPlayer::update()
 void AnimationPlayer::draw(Vector2 position, Vector2 scale, Vector2 origin, float rotation, bool flipX, bool flipY)
 {
 	if (getCurrentAnimation() == nullptr) {
-		DrawTexture(texture, position.x, position.x, WHITE);
+		DrawTexture(texture.get(), position.x, position.x, WHITE);
 		return;
 	}
 
@@ -181,7 +227,7 @@ void AnimationPlayer::draw(Vector2 position, Vector2 scale, Vector2 origin, floa
 	if (flipY) source.height = -source.height;
 
 	DrawTexturePro(
-		texture,
+		texture.get(),
 		source,
 		{
 			position.x,
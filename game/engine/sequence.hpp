@@ -3,6 +3,7 @@
 #include <vector>
 #include <raylib.h>
 #include <nlohmann/json.hpp>
+#include "utils.hpp"
 
 enum AnimationType
 {
@@ -42,29 +43,43 @@ class AnimationPlayer
 public:
 	AnimationPlayer() {}
 	AnimationPlayer(std::string animFile);
+	AnimationPlayer(const AnimationPlayer&) = delete;
+	AnimationPlayer& operator=(const AnimationPlayer&) = delete;
+	~AnimationPlayer();
+
+	// Copies the parsed animations without reading the file again. The copy
+	// borrows the texture, so this player has to outlive it.
+	AnimationPlayer* clone() const;
 
 	inline std::string getAnimationPath() const { return animFile; }
 	inline std::string getTexturePath() const { return texturePath; }
 
 	inline std::map<std::string, Animation*>& getAnimations() { return animations; }
 
-	inline Texture2D getTexture() const { return texture; }
+	inline Texture2D getTexture() const { return texture.get(); }
 
 	inline AnimationType getType() const { return type; }
 
 	inline bool isPlaying() const { return playing; }
 
+	inline std::string getCurrentAnimationName() const { return currentAnimationName; }
+	inline int getCurrentFrameIndex() const { return currentFrameIndex; }
+	inline float getTimer() const { return timer; }
+
 	inline Animation* getCurrentAnimation() { return animations[currentAnimationName]; }
 	inline AnimationFrame& getCurrentFrame() { return getCurrentAnimation()->getFrame(currentFrameIndex); }
 
 	inline Rectangle getSource() {
-		Rectangle defaultRect = { 0, 0, (float)texture.width, (float)texture.height };
+		Rectangle defaultRect = { 0, 0, (float)texture.get().width, (float)texture.get().height };
 		return getCurrentAnimation() != nullptr ? getCurrentFrame().source : defaultRect;
 	}
 
 	void play(std::string name, bool repeat);
 	void stop();
+	// Puts playback back to a previously saved point
+	void setPlaybackState(std::string name, int frameIndex, float timer, bool playing);
 	void update();
+	void update(float delta);
 	void draw(Vector2 position, Vector2 scale, Vector2 origin, float rotation = 0, bool flipX = false, bool flipY = false);
 
 private:
@@ -73,7 +88,7 @@ private:
 	std::map<std::string, Animation*> animations;
 	AnimationType type;
 
-	Texture2D texture;
+	TextureHandle texture;
 	bool playing = false;
 	float timer = 0;
 
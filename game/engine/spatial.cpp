@@ -0,0 +1,248 @@
+#include "spatial.hpp"
+#include <algorithm>
+#include <cmath>
+
+SpatialGrid::SpatialGrid(int width, int height, int cellSize, int cellsPerBucket)
+{
+	this->bucketSize = (float)(cellSize * cellsPerBucket);
+	this->inverseBucketSize = 1.0f / bucketSize;
+	this->columns = std::max((width + cellsPerBucket - 1) / cellsPerBucket, 1);
+	this->rows = std::max((height + cellsPerBucket - 1) / cellsPerBucket, 1);
+
+	buckets.resize(columns * rows);
+}
+
+int SpatialGrid::insert(Vector2 position)
+{
+	int id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else {
+		id = entities.size();
+		entities.emplace_back();
+	}
+
+	entities[id].orderKey = 0;
+	addToBucket(id, bucketIndex(position), position);
+	count++;
+	return id;
+}
+
+void SpatialGrid::remove(int id)
+{
+	if (!contains(id)) return;
+
+	removeFromBucket(id);
+	entities[id].bucket = -1;
+	freeIds.push_back(id);
+	count--;
+}
+
+void SpatialGrid::move(int id, Vector2 position)
+{
+	if (!contains(id)) return;
+
+	Entity& entity = entities[id];
+	int newBucket = bucketIndex(position);
+
+	// Most moves stay inside the same bucket
+	if (newBucket == entity.bucket) {
+		Bucket& bucket = buckets[entity.bucket];
+		bucket.xs[entity.slot] = position.x;
+		bucket.ys[entity.slot] = position.y;
+		return;
+	}
+
+	removeFromBucket(id);
+	addToBucket(id, newBucket, position);
+}
+
+void SpatialGrid::clear()
+{
+	for (Bucket& bucket : buckets) {
+		bucket.xs.clear();
+		bucket.ys.clear();
+		bucket.ids.clear();
+	}
+
+	entities.clear();
+	freeIds.clear();
+	count = 0;
+}
+
+void SpatialGrid::addToBucket(int id, int bucketIndex, Vector2 position)
+{
+	Bucket& bucket = buckets[bucketIndex];
+	entities[id].bucket = bucketIndex;
+	entities[id].slot = bucket.ids.size();
+
+	bucket.xs.push_back(position.x);
+	bucket.ys.push_back(position.y);
+	bucket.ids.push_back(id);
+}
+
+void SpatialGrid::removeFromBucket(int id)
+{
+	Entity& entity = entities[id];
+	Bucket& bucket = buckets[entity.bucket];
+
+	// Swap with the last slot to keep the arrays packed
+	int last = bucket.ids.size() - 1;
+	if (entity.slot != last) {
+		bucket.xs[entity.slot] = bucket.xs[last];
+		bucket.ys[entity.slot] = bucket.ys[last];
+		bucket.ids[entity.slot] = bucket.ids[last];
+		entities[bucket.ids[last]].slot = entity.slot;
+	}
+
+	bucket.xs.pop_back();
+	bucket.ys.pop_back();
+	bucket.ids.pop_back();
+}
+
+float* SpatialGrid::computeDistances(const Bucket& bucket, Vector2 center)
+{
+	int size = bucket.ids.size();
+	if (distances.size() < size) distances.resize(size);
+
+	// Kept branch-free so the compiler can vectorize it
+	const float* xs = bucket.xs.data();
+	const float* ys = bucket.ys.data();
+	float* out = distances.data();
+	for (int i = 0; i < size; i++) {
+		float dx = xs[i] - center.x;
+		float dy = ys[i] - center.y;
+		out[i] = dx * dx + dy * dy;
+	}
+
+	return out;
+}
+
+void SpatialGrid::queryRadius(Vector2 center, float radius, std::vector<int>& out)
+{
+	float radiusSquared = radius * radius;
+
+	int startCol = bucketColumn(center.x - radius);
+	int endCol = bucketColumn(center.x + radius);
+	int startRow = bucketRow(center.y - radius);
+	int endRow = bucketRow(center.y + radius);
+
+	for (int i = startRow; i <= endRow; i++) {
+		for (int j = startCol; j <= endCol; j++) {
+			const Bucket& bucket = buckets[i * columns + j];
+			if (bucket.ids.empty()) continue;
+
+			// Buckets entirely inside the circle skip the distance test
+			float farX = std::max(std::abs(j * bucketSize - center.x), std::abs((j + 1) * bucketSize - center.x));
+			float farY = std::max(std::abs(i * bucketSize - center.y), std::abs((i + 1) * bucketSize - center.y));
+			bool interior = farX * farX + farY * farY <= radiusSquared
+				&& j > 0 && i > 0 && j < columns - 1 && i < rows - 1;
+
+			if (interior) {
+				out.insert(out.end(), bucket.ids.begin(), bucket.ids.end());
+				continue;
+			}
+
+			float* bucketDistances = computeDistances(bucket, center);
+			for (int k = 0; k < bucket.ids.size(); k++) {
+				if (bucketDistances[k] <= radiusSquared) out.push_back(bucket.ids[k]);
+			}
+		}
+	}
+}
+
+void SpatialGrid::collectRing(Vector2 center, int centerRow, int centerCol, int ring, float maxRadiusSquared)
+{
+	int startRow = centerRow - ring;
+	int endRow = centerRow + ring;
+	int startCol = centerCol - ring;
+	int endCol = centerCol + ring;
+
+	for (int i = std::max(startRow, 0); i <= std::min(endRow, rows - 1); i++) {
+		bool edgeRow = i == startRow || i == endRow;
+		int step = edgeRow ? 1 : endCol - startCol;
+
+		for (int j = startCol; j <= endCol; j += std::max(step, 1)) {
+			if (j < 0 || j >= columns) continue;
+
+			const Bucket& bucket = buckets[i * columns + j];
+			if (bucket.ids.empty()) continue;
+
+			float* bucketDistances = computeDistances(bucket, center);
+			for (int k = 0; k < bucket.ids.size(); k++) {
+				if (bucketDistances[k] <= maxRadiusSquared) candidates.push_back({ bucketDistances[k], bucket.ids[k] });
+			}
+		}
+	}
+}
+
+void SpatialGrid::queryNearest(Vector2 center, int k, float maxRadius, std::vector<int>& out)
+{
+	if (k <= 0 || count == 0) return;
+
+	float maxRadiusSquared = maxRadius * maxRadius;
+	int centerRow = bucketRow(center.y);
+	int centerCol = bucketColumn(center.x);
+	int maxRing = std::max(rows, columns);
+
+	candidates.clear();
+	for (int ring = 0; ring <= maxRing; ring++) {
+		// Anything in a further ring is at least this far away
+		float ringDistance = std::max(ring - 1, 0) * bucketSize;
+		if (ringDistance * ringDistance > maxRadiusSquared) break;
+
+		if (candidates.size() >= k) {
+			std::nth_element(candidates.begin(), candidates.begin() + (k - 1), candidates.end());
+			if (candidates[k - 1].first <= ringDistance * ringDistance) break;
+		}
+
+		collectRing(center, centerRow, centerCol, ring, maxRadiusSquared);
+	}
+
+	int found = std::min((int)candidates.size(), k);
+	std::partial_sort(candidates.begin(), candidates.begin() + found, candidates.end());
+	for (int i = 0; i < found; i++) {
+		out.push_back(candidates[i].second);
+	}
+}
+
+int SpatialGrid::queryNearest(Vector2 center, float maxRadius)
+{
+	std::vector<int> nearest;
+	queryNearest(center, 1, maxRadius, nearest);
+	return nearest.empty() ? -1 : nearest[0];
+}
+
+int SpatialGrid::queryFirst(Vector2 center, float radius)
+{
+	float radiusSquared = radius * radius;
+
+	int startCol = bucketColumn(center.x - radius);
+	int endCol = bucketColumn(center.x + radius);
+	int startRow = bucketRow(center.y - radius);
+	int endRow = bucketRow(center.y + radius);
+
+	int best = -1;
+	float bestKey = 0;
+	for (int i = startRow; i <= endRow; i++) {
+		for (int j = startCol; j <= endCol; j++) {
+			const Bucket& bucket = buckets[i * columns + j];
+			if (bucket.ids.empty()) continue;
+
+			float* bucketDistances = computeDistances(bucket, center);
+			for (int k = 0; k < bucket.ids.size(); k++) {
+				if (bucketDistances[k] > radiusSquared) continue;
+
+				float key = entities[bucket.ids[k]].orderKey;
+				if (best == -1 || key > bestKey) {
+					best = bucket.ids[k];
+					bestKey = key;
+				}
+			}
+		}
+	}
+
+	return best;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <raylib.h>
+#include <vector>
+#include <cstdint>
+
+// Uniform grid of moving points aligned to the map cells.
+// Each bucket stores its entities as separate x / y / id arrays so the
+// distance test in queries runs over contiguous floats.
+class SpatialGrid
+{
+public:
+	// width and height are in map cells, cellSize in pixels.
+	// cellsPerBucket groups several map cells into one bucket.
+	SpatialGrid(int width, int height, int cellSize, int cellsPerBucket = 1);
+
+	inline int getColumns() const { return columns; }
+	inline int getRows() const { return rows; }
+	inline float getBucketSize() const { return bucketSize; }
+	inline int getCount() const { return count; }
+
+	int insert(Vector2 position);
+	void remove(int id);
+	void move(int id, Vector2 position);
+	void clear();
+
+	inline bool contains(int id) const { return id >= 0 && id < entities.size() && entities[id].bucket >= 0; }
+	inline Vector2 getPosition(int id) const {
+		const Entity& entity = entities[id];
+		const Bucket& bucket = buckets[entity.bucket];
+		return { bucket.xs[entity.slot], bucket.ys[entity.slot] };
+	}
+
+	// Used by queryFirst, e.g. the distance an enemy has walked along its path
+	inline void setOrderKey(int id, float key) { entities[id].orderKey = key; }
+	inline float getOrderKey(int id) const { return entities[id].orderKey; }
+
+	// Appends ids of all entities within radius, in no particular order
+	void queryRadius(Vector2 center, float radius, std::vector<int>& out);
+	// Appends up to k nearest ids within maxRadius, closest first
+	void queryNearest(Vector2 center, int k, float maxRadius, std::vector<int>& out);
+	// -1 when nothing is in range
+	int queryNearest(Vector2 center, float maxRadius);
+	// Entity in range with the highest order key, -1 when nothing is in range
+	int queryFirst(Vector2 center, float radius);
+
+private:
+	struct Bucket
+	{
+		std::vector<float> xs;
+		std::vector<float> ys;
+		std::vector<int> ids;
+	};
+
+	struct Entity
+	{
+		int bucket = -1;
+		int slot = 0;
+		float orderKey = 0;
+	};
+
+	int columns;
+	int rows;
+	float bucketSize;
+	float inverseBucketSize;
+	int count = 0;
+
+	std::vector<Bucket> buckets;
+	std::vector<Entity> entities;
+	std::vector<int> freeIds;
+
+	std::vector<float> distances;
+	std::vector<std::pair<float, int>> candidates;
+
+	inline int bucketColumn(float x) const {
+		int col = (int)(x * inverseBucketSize);
+		return col < 0 ? 0 : (col >= columns ? columns - 1 : col);
+	}
+	inline int bucketRow(float y) const {
+		int row = (int)(y * inverseBucketSize);
+		return row < 0 ? 0 : (row >= rows ? rows - 1 : row);
+	}
+	inline int bucketIndex(Vector2 position) const { return bucketRow(position.y) * columns + bucketColumn(position.x); }
+
+	void addToBucket(int id, int bucketIndex, Vector2 position);
+	void removeFromBucket(int id);
+	float* computeDistances(const Bucket& bucket, Vector2 center);
+	void collectRing(Vector2 center, int centerRow, int centerCol, int ring, float maxRadiusSquared);
+};
@@ -0,0 +1,384 @@
+#include "spawning.hpp"
+#include <nlohmann/json.hpp>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// Schedule
+WaveSchedule* WaveSchedule::fromFile(std::string path)
+{
+	std::ifstream scheduleFile(path);
+	if (!scheduleFile.is_open()) {
+		TraceLog(LOG_WARNING, ("SPAWNER: Could not open wave schedule " + path).c_str());
+		return nullptr;
+	}
+
+	nlohmann::json scheduleData = nlohmann::json::parse(scheduleFile);
+	WaveSchedule* schedule = new WaveSchedule();
+
+	if (scheduleData.contains("enemies")) {
+		for (auto& item : scheduleData["enemies"].items()) {
+			nlohmann::json& data = item.value();
+
+			EnemyType type;
+			type.name = item.key();
+			type.animationFile = data["animation"];
+			if (data.contains("play")) type.animation = data["play"];
+			if (data.contains("sound")) type.sound = SoundBank::load(data["sound"]);
+
+			if (data.contains("scale")) {
+				nlohmann::json& scale = data["scale"];
+				type.scale = scale.is_array() ? Vector2{ scale[0], scale[1] } : Vector2{ scale, scale };
+			}
+
+			schedule->enemyTypes.push_back(type);
+		}
+	}
+
+	if (scheduleData.contains("spawnPoints")) {
+		for (auto& point : scheduleData["spawnPoints"]) {
+			schedule->spawnPoints.push_back({ point[0], point[1] });
+		}
+	}
+	if (schedule->spawnPoints.empty()) schedule->spawnPoints.push_back({ 0, 0 });
+
+	if (scheduleData.contains("waves")) {
+		for (auto& waveData : scheduleData["waves"]) {
+			EnemyWave wave;
+			if (waveData.contains("delay")) wave.delay = waveData["delay"];
+
+			for (auto& groupData : waveData["groups"]) {
+				SpawnGroup group;
+				group.enemyType = schedule->findEnemyType(groupData["enemy"]);
+				if (group.enemyType < 0) {
+					TraceLog(LOG_WARNING, ("SPAWNER: Unknown enemy " + (std::string)groupData["enemy"] + " in " + path).c_str());
+					continue;
+				}
+
+				if (groupData.contains("spawnPoint")) group.spawnPoint = groupData["spawnPoint"];
+				if (groupData.contains("count")) group.count = groupData["count"];
+				if (groupData.contains("start")) group.start = groupData["start"];
+				if (groupData.contains("interval")) group.interval = groupData["interval"];
+
+				group.spawnPoint = std::clamp(group.spawnPoint, 0, (int)schedule->spawnPoints.size() - 1);
+				group.start = std::max(group.start, 0.0f);
+				group.interval = std::max(group.interval, 0.0f);
+				wave.groups.push_back(group);
+			}
+
+			schedule->waves.push_back(wave);
+		}
+	}
+
+	return schedule;
+}
+
+int WaveSchedule::findEnemyType(std::string name) const
+{
+	for (int i = 0; i < enemyTypes.size(); i++) {
+		if (enemyTypes[i].name == name) return i;
+	}
+	return -1;
+}
+
+// Spawner
+WaveSpawner::WaveSpawner(Map* map, WaveSchedule* schedule)
+{
+	this->map = map;
+	this->schedule = schedule;
+
+	for (const EnemyType& type : schedule->enemyTypes) {
+		templates.push_back(new AnimationPlayer(type.animationFile));
+	}
+
+	pools.resize(templates.size());
+	freeEnemies.resize(templates.size());
+	prewarmTargets.assign(templates.size(), 0);
+
+	if (!schedule->waves.empty()) nextWaveStart = schedule->waves[0].delay;
+}
+
+WaveSpawner::~WaveSpawner()
+{
+	// Enemies borrow the template textures, take them off the map first
+	for (std::vector<std::shared_ptr<Enemy>>& pool : pools) {
+		for (std::shared_ptr<Enemy>& enemy : pool) despawn(enemy.get());
+	}
+	flushDespawned();
+	pools.clear();
+
+	for (AnimationPlayer* player : templates) delete player;
+}
+
+void WaveSpawner::setMap(Map* map)
+{
+	if (this->map == map) return;
+
+	for (std::vector<std::shared_ptr<Enemy>>& pool : pools) {
+		for (std::shared_ptr<Enemy>& enemy : pool) despawn(enemy.get());
+	}
+	flushDespawned();
+
+	this->map = map;
+}
+
+int WaveSpawner::createEnemy(int type)
+{
+	std::shared_ptr<Enemy> enemy = std::make_shared<Enemy>(type, templates[type]->clone());
+	enemy->poolIndex = pools[type].size();
+	enemy->setPoolSlot(type, enemy->poolIndex);
+	pools[type].push_back(enemy);
+	return enemy->poolIndex;
+}
+
+void WaveSpawner::planWave(int index)
+{
+	const EnemyWave& wave = schedule->waves[index];
+
+	spawns.clear();
+	spawnCursor = 0;
+	std::fill(prewarmTargets.begin(), prewarmTargets.end(), 0);
+
+	for (const SpawnGroup& group : wave.groups) {
+		for (int i = 0; i < group.count; i++) {
+			spawns.push_back({ nextWaveStart + group.start + i * group.interval, group.enemyType, group.spawnPoint });
+		}
+		prewarmTargets[group.enemyType] += group.count;
+	}
+
+	std::stable_sort(spawns.begin(), spawns.end(), [](const PendingSpawn& a, const PendingSpawn& b) { return a.time < b.time; });
+
+	// Keep addSprite from reallocating mid-wave
+	map->getSprites().reserve(map->getSprites().size() + spawns.size());
+
+	plannedWave = index;
+}
+
+void WaveSpawner::spawn(const PendingSpawn& pending)
+{
+	int type = pending.enemyType;
+
+	int index;
+	if (!freeEnemies[type].empty()) {
+		index = freeEnemies[type].back();
+		freeEnemies[type].pop_back();
+		stats.recycled++;
+	}
+	else {
+		index = createEnemy(type);
+		stats.coldSpawns++;
+	}
+
+	std::shared_ptr<Enemy>& enemy = pools[type][index];
+	const EnemyType& data = schedule->enemyTypes[type];
+	Vector2 cell = schedule->spawnPoints[pending.spawnPoint];
+	float cellSize = map->getCellSize();
+
+	enemy->setPosition({ (cell.x + 0.5f) * cellSize, (cell.y + 0.5f) * cellSize });
+	enemy->setScale(data.scale);
+	enemy->setFlipX(false);
+	enemy->setFlipY(false);
+	enemy->getAnimationPlayer()->setPlaybackState(data.animation, 0, 0, !data.animation.empty());
+	enemy->setSound(data.sound);
+	enemy->active = true;
+	map->addSprite(enemy);
+	enemy->playSound(mixer);
+
+	prewarmTargets[type] = std::max(prewarmTargets[type] - 1, 0);
+
+	double latency = (time - pending.time) * 1000.0;
+	stats.spawned++;
+	stats.totalLatencyMs += latency;
+	stats.maxLatencyMs = std::max(stats.maxLatencyMs, latency);
+	waveMaxLatencyMs = std::max(waveMaxLatencyMs, latency);
+}
+
+void WaveSpawner::despawn(Enemy* enemy)
+{
+	if (enemy == nullptr || !enemy->active) return;
+
+	enemy->active = false;
+	despawned.insert(enemy);
+}
+
+void WaveSpawner::flushDespawned()
+{
+	if (despawned.empty()) return;
+
+	// One pass over the sprite list for the whole batch
+	if (map) std::erase_if(map->getSprites(), [this](const std::shared_ptr<Sprite>& sprite) { return despawned.contains(sprite.get()); });
+
+	for (Sprite* sprite : despawned) {
+		Enemy* enemy = static_cast<Enemy*>(sprite);
+		freeEnemies[enemy->type].push_back(enemy->poolIndex);
+	}
+
+	stats.despawned += despawned.size();
+	despawned.clear();
+}
+
+void WaveSpawner::saveState(std::vector<uint8_t>& out) const
+{
+	SavedState state = { time, nextWaveStart, nextWave, plannedWave, spawnCursor, stats.wave, waveRunning };
+
+	// Followed by the enemies on the map, so a load can take back the ones spawned after the save
+	std::vector<SavedEnemy> enemies;
+	for (const std::vector<std::shared_ptr<Enemy>>& pool : pools) {
+		for (const std::shared_ptr<Enemy>& enemy : pool) {
+			if (enemy->active) enemies.push_back({ enemy->type, enemy->poolIndex });
+		}
+	}
+
+	out.resize(sizeof(state) + enemies.size() * sizeof(SavedEnemy));
+	std::memcpy(out.data(), &state, sizeof(state));
+	if (!enemies.empty()) std::memcpy(out.data() + sizeof(state), enemies.data(), enemies.size() * sizeof(SavedEnemy));
+}
+
+bool WaveSpawner::loadState(const std::vector<uint8_t>& data)
+{
+	hasSavedEnemies = false;
+	savedEnemies.clear();
+
+	SavedState state;
+	if (data.size() < sizeof(state) || (data.size() - sizeof(state)) % sizeof(SavedEnemy) != 0) return false;
+	std::memcpy(&state, data.data(), sizeof(state));
+
+	int waveCount = schedule->waves.size();
+	if (state.nextWave < 0 || state.nextWave > waveCount || state.plannedWave < -1 || state.plannedWave >= waveCount) return false;
+
+	// Pools only grow, so every enemy of an earlier save still exists
+	std::vector<SavedEnemy> enemies((data.size() - sizeof(state)) / sizeof(SavedEnemy));
+	if (!enemies.empty()) std::memcpy(enemies.data(), data.data() + sizeof(state), enemies.size() * sizeof(SavedEnemy));
+	for (const SavedEnemy& saved : enemies) {
+		std::shared_ptr<Sprite> enemy = findSprite(saved.type, saved.poolIndex);
+		if (enemy == nullptr) return false;
+		savedEnemies.insert(enemy.get());
+	}
+	hasSavedEnemies = true;
+
+	time = state.time;
+	nextWaveStart = state.nextWaveStart;
+	nextWave = state.nextWave;
+	waveRunning = state.waveRunning;
+	stats.wave = state.wave;
+
+	// The spawn list only depends on the wave and its start time, so it is
+	// planned again and the cursor put back where it was
+	bool hasSpawns = state.plannedWave >= 0 && (waveRunning || state.plannedWave == nextWave);
+	if (hasSpawns) {
+		planWave(state.plannedWave);
+		spawnCursor = std::clamp((int)state.spawnCursor, 0, (int)spawns.size());
+
+		std::fill(prewarmTargets.begin(), prewarmTargets.end(), 0);
+		for (int i = spawnCursor; i < spawns.size(); i++) prewarmTargets[spawns[i].enemyType]++;
+	}
+	else {
+		spawns.clear();
+		spawnCursor = 0;
+		std::fill(prewarmTargets.begin(), prewarmTargets.end(), 0);
+	}
+
+	plannedWave = state.plannedWave;
+	return true;
+}
+
+std::shared_ptr<Sprite> WaveSpawner::findSprite(int pool, int slot)
+{
+	if (pool < 0 || pool >= pools.size() || slot < 0 || slot >= pools[pool].size()) return nullptr;
+	return pools[pool][slot];
+}
+
+void WaveSpawner::reconcile()
+{
+	despawned.clear();
+	for (std::vector<std::shared_ptr<Enemy>>& pool : pools) {
+		for (std::shared_ptr<Enemy>& enemy : pool) enemy->active = false;
+	}
+
+	// Enemies the loaded state doesn't list were spawned after the save, the
+	// rewound spawn cursor would bring them back a second time
+	if (map) {
+		std::erase_if(map->getSprites(), [this](const std::shared_ptr<Sprite>& sprite) {
+			Enemy* enemy = dynamic_cast<Enemy*>(sprite.get());
+			if (enemy == nullptr || findSprite(enemy->type, enemy->poolIndex).get() != enemy) return false;
+			if (enemy->active || (hasSavedEnemies && !savedEnemies.contains(enemy))) return true;
+
+			enemy->active = true;
+			return false;
+		});
+	}
+	hasSavedEnemies = false;
+	savedEnemies.clear();
+
+	for (int type = 0; type < pools.size(); type++) {
+		freeEnemies[type].clear();
+		for (std::shared_ptr<Enemy>& enemy : pools[type]) {
+			if (!enemy->active) freeEnemies[type].push_back(enemy->poolIndex);
+		}
+	}
+}
+
+void WaveSpawner::update(float delta)
+{
+	using Clock = std::chrono::steady_clock;
+	Clock::time_point start = Clock::now();
+	auto elapsedMs = [&start]() { return std::chrono::duration<double, std::milli>(Clock::now() - start).count(); };
+
+	time += delta;
+	flushDespawned();
+
+	// Plan the next wave as soon as its pre-warm window opens
+	if (!waveRunning && plannedWave < nextWave && nextWave < schedule->waves.size() && time >= nextWaveStart - prewarmLead) {
+		planWave(nextWave);
+	}
+
+	if (!waveRunning && plannedWave == nextWave && time >= nextWaveStart) {
+		waveRunning = true;
+		waveStartStats = stats;
+		waveMaxLatencyMs = 0;
+		stats.wave = nextWave;
+		nextWave++;
+	}
+
+	// Due spawns first, at least one per tick so a tight budget still makes progress
+	int processed = 0;
+	while (spawnCursor < spawns.size() && spawns[spawnCursor].time <= time) {
+		if (processed > 0 && elapsedMs() >= budgetMs) break;
+
+		spawn(spawns[spawnCursor++]);
+		processed++;
+	}
+
+	// Then fill the pools with what is left of the budget
+	for (int type = 0; type < pools.size(); type++) {
+		while (freeEnemies[type].size() < prewarmTargets[type] && elapsedMs() < budgetMs) {
+			freeEnemies[type].push_back(createEnemy(type));
+			stats.prewarmed++;
+		}
+	}
+
+	if (waveRunning && spawnCursor >= spawns.size()) {
+		waveRunning = false;
+		spawns.clear();
+		spawnCursor = 0;
+
+		TraceLog(LOG_INFO, ("SPAWNER: Wave " + std::to_string(stats.wave + 1) + " done, "
+			+ std::to_string(stats.spawned - waveStartStats.spawned) + " spawned ("
+			+ std::to_string(stats.coldSpawns - waveStartStats.coldSpawns) + " cold), max latency "
+			+ std::to_string(waveMaxLatencyMs) + " ms, "
+			+ std::to_string(stats.hitches - waveStartStats.hitches) + " hitches").c_str());
+
+		if (nextWave < schedule->waves.size()) nextWaveStart = time + schedule->waves[nextWave].delay;
+	}
+
+	stats.pending = 0;
+	for (int i = spawnCursor; i < spawns.size() && spawns[i].time <= time; i++) stats.pending++;
+
+	stats.pooled = 0;
+	for (std::vector<int>& available : freeEnemies) stats.pooled += available.size();
+
+	stats.lastTickMs = elapsedMs();
+	stats.maxTickMs = std::max(stats.maxTickMs, stats.lastTickMs);
+	if (stats.lastTickMs > hitchThresholdMs) stats.hitches++;
+}
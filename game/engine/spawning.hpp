@@ -0,0 +1,205 @@
+#pragma once
+#include <raylib.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_set>
+#include "sequence.hpp"
+#include "world.hpp"
+#include "savestate.hpp"
+
+struct EnemyType
+{
+	std::string name;
+	std::string animationFile;
+	// Animation played when the enemy spawns
+	std::string animation;
+	Vector2 scale = { 1, 1 };
+	// Played when the enemy spawns
+	SoundId sound = INVALID_SOUND;
+};
+
+// count enemies of one type, the first one start seconds into the wave,
+// the rest interval seconds apart
+struct SpawnGroup
+{
+	int enemyType = 0;
+	int spawnPoint = 0;
+	int count = 0;
+	float start = 0;
+	float interval = 0;
+};
+
+struct EnemyWave
+{
+	// Seconds between the last spawn of the previous wave and the start of this one
+	float delay = 0;
+	std::vector<SpawnGroup> groups;
+};
+
+struct WaveSchedule
+{
+	std::vector<EnemyType> enemyTypes;
+	// In map cells, enemies appear at the cell center
+	std::vector<Vector2> spawnPoints;
+	std::vector<EnemyWave> waves;
+
+	static WaveSchedule* fromFile(std::string path);
+
+	int findEnemyType(std::string name) const;
+};
+
+// Pooled sprite handed out by WaveSpawner. It owns its animation player,
+// a clone of the template loaded for its type.
+class Enemy : public Sprite
+{
+public:
+	Enemy(int type, AnimationPlayer* animPlayer) : Sprite(animPlayer, { 0, 0 }), type(type) {}
+	Enemy(const Enemy&) = delete;
+	Enemy& operator=(const Enemy&) = delete;
+	~Enemy() { delete animPlayer; }
+
+	inline int getType() const { return type; }
+	inline bool isActive() const { return active; }
+
+private:
+	friend class WaveSpawner;
+
+	int type;
+	int poolIndex = -1;
+	bool active = false;
+};
+
+struct SpawnerStats
+{
+	int wave = -1;
+	uint64_t spawned = 0;
+	uint64_t recycled = 0;
+	uint64_t despawned = 0;
+	// Enemies created ahead of a wave, and ones that had to be created on spawn
+	uint64_t prewarmed = 0;
+	uint64_t coldSpawns = 0;
+	int pending = 0;
+	int pooled = 0;
+
+	// Simulation time between when a spawn was scheduled and when it happened
+	double totalLatencyMs = 0;
+	double maxLatencyMs = 0;
+
+	// Wall time spent in update()
+	double lastTickMs = 0;
+	double maxTickMs = 0;
+	int hitches = 0;
+
+	inline double getAverageLatencyMs() const { return spawned > 0 ? totalLatencyMs / spawned : 0; }
+};
+
+// Runs a WaveSchedule on a map. Each type's animation file is parsed once,
+// up front, and enemies are clones of that template kept in per-type pools.
+// Pools are topped up before a wave starts and despawned enemies go back to
+// them. Spawning and pre-warming share a per-tick time budget, spawns that
+// don't fit are carried over to the next tick.
+class WaveSpawner : public SpriteSource
+{
+public:
+	// Loads textures, so it has to be created on the main thread
+	WaveSpawner(Map* map, WaveSchedule* schedule);
+	WaveSpawner(const WaveSpawner&) = delete;
+	WaveSpawner& operator=(const WaveSpawner&) = delete;
+	~WaveSpawner();
+
+	inline WaveSchedule* getSchedule() { return schedule; }
+	inline Map* getMap() { return map; }
+	// Takes every enemy off the current map and spawns on the new one from now on
+	void setMap(Map* map);
+	inline void setMixer(SoundMixer* mixer) { this->mixer = mixer; }
+	inline SpawnerStats getStats() const { return stats; }
+	inline bool isFinished() const { return nextWave >= schedule->waves.size() && !waveRunning; }
+
+	inline double getBudget() const { return budgetMs; }
+	inline void setBudget(double budgetMs) { this->budgetMs = budgetMs; }
+	// Ticks where update() takes longer than this count as hitches
+	inline double getHitchThreshold() const { return hitchThresholdMs; }
+	inline void setHitchThreshold(double hitchThresholdMs) { this->hitchThresholdMs = hitchThresholdMs; }
+	// Seconds before a wave starts when its pools begin to fill
+	inline float getPrewarmLead() const { return prewarmLead; }
+	inline void setPrewarmLead(float prewarmLead) { this->prewarmLead = prewarmLead; }
+
+	void update(float delta);
+
+	// Removed from the map on the next update, then reused by later spawns
+	void despawn(Enemy* enemy);
+	// Schedule progress, stored in GameSnapshot::userData so a rollback or
+	// quick load rewinds the waves together with the map
+	void saveState(std::vector<uint8_t>& out) const;
+	bool loadState(const std::vector<uint8_t>& data);
+	// Pool is the enemy type, slot the index in that type's pool
+	std::shared_ptr<Sprite> findSprite(int pool, int slot) override;
+	// Re-reads which enemies are on the map, after the sprite list was
+	// replaced by a snapshot restore. After a successful loadState, enemies
+	// the saved state doesn't list are taken off the map.
+	void reconcile();
+
+private:
+	struct SavedState
+	{
+		float time;
+		float nextWaveStart;
+		int32_t nextWave;
+		int32_t plannedWave;
+		int32_t spawnCursor;
+		int32_t wave;
+		uint8_t waveRunning;
+	};
+
+	struct SavedEnemy
+	{
+		int32_t type;
+		int32_t poolIndex;
+	};
+
+	struct PendingSpawn
+	{
+		float time;
+		int enemyType;
+		int spawnPoint;
+	};
+
+	Map* map;
+	WaveSchedule* schedule;
+	SoundMixer* mixer = nullptr;
+
+	std::vector<AnimationPlayer*> templates;
+	std::vector<std::vector<std::shared_ptr<Enemy>>> pools;
+	// Pool indices of the enemies that are not on the map
+	std::vector<std::vector<int>> freeEnemies;
+	std::unordered_set<Sprite*> despawned;
+	// Enemies listed by the last loadState, until reconcile
+	std::unordered_set<Sprite*> savedEnemies;
+	bool hasSavedEnemies = false;
+
+	double budgetMs = 1;
+	double hitchThresholdMs = 4;
+	float prewarmLead = 3;
+
+	float time = 0;
+	int nextWave = 0;
+	float nextWaveStart = 0;
+	int plannedWave = -1;
+	bool waveRunning = false;
+
+	// Spawns of the planned wave, sorted by time
+	std::vector<PendingSpawn> spawns;
+	int spawnCursor = 0;
+	// Enemies of each type the planned wave still has to spawn
+	std::vector<int> prewarmTargets;
+
+	SpawnerStats stats;
+	SpawnerStats waveStartStats;
+	double waveMaxLatencyMs = 0;
+
+	void planWave(int index);
+	int createEnemy(int type);
+	void spawn(const PendingSpawn& pending);
+	void flushDespawned();
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Single producer / single consumer triple buffer. The producer always has a
+// buffer to write into, the consumer always sees the latest published one
+// and neither side ever waits.
+template<typename T>
+class TripleBuffer
+{
+public:
+	// Producer side
+	inline T& getWriteBuffer() { return buffers[writeIndex]; }
+	inline void publish() {
+		int previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+		writeIndex = previous & INDEX_MASK;
+	}
+
+	// Consumer side. Returns the newest published buffer, or the one returned
+	// last time when nothing new was published.
+	inline const T& read() {
+		if (middle.load(std::memory_order_relaxed) & FRESH_BIT) {
+			int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+			readIndex = previous & INDEX_MASK;
+		}
+		return buffers[readIndex];
+	}
+	inline bool hasFresh() const { return middle.load(std::memory_order_relaxed) & FRESH_BIT; }
+
+private:
+	static const int FRESH_BIT = 4;
+	static const int INDEX_MASK = 3;
+
+	T buffers[3];
+	int writeIndex = 0;
+	int readIndex = 1;
+	std::atomic<int> middle = 2;
+};
+
+// Bounded lock-free single producer / single consumer ring
+template<typename T, size_t Capacity>
+class SpscQueue
+{
+public:
+	// False when the queue is full
+	inline bool push(const T& item) {
+		size_t tail = this->tail.load(std::memory_order_relaxed);
+		size_t next = (tail + 1) % (Capacity + 1);
+		if (next == head.load(std::memory_order_acquire)) return false;
+
+		items[tail] = item;
+		this->tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// False when the queue is empty
+	inline bool pop(T& item) {
+		size_t head = this->head.load(std::memory_order_relaxed);
+		if (head == tail.load(std::memory_order_acquire)) return false;
+
+		item = items[head];
+		this->head.store((head + 1) % (Capacity + 1), std::memory_order_release);
+		return true;
+	}
+
+	inline bool isEmpty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+
+private:
+	T items[Capacity + 1];
+	alignas(64) std::atomic<size_t> head = 0;
+	alignas(64) std::atomic<size_t> tail = 0;
+};
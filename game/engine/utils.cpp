@@ -1,19 +1,205 @@
 #include "utils.hpp"
+#include <vector>
+#include <algorithm>
 
-std::map<std::string, Texture2D> AssetManager::loadedTextures;
+// Texture handles
+TextureHandle::TextureHandle(const TextureHandle& other) : path(other.path), texture(other.texture) {
+    if (isManaged()) AssetManager::retainTexture(path);
+}
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept : path(std::move(other.path)), texture(other.texture) {
+    other.path.clear();
+    other.texture = { 0 };
+}
+
+TextureHandle& TextureHandle::operator=(const TextureHandle& other) {
+    if (this == &other) return *this;
+
+    if (other.isManaged()) AssetManager::retainTexture(other.path);
+    reset();
+
+    path = other.path;
+    texture = other.texture;
+    return *this;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle&& other) noexcept {
+    if (this == &other) return *this;
+
+    reset();
+
+    path = std::move(other.path);
+    texture = other.texture;
+    other.path.clear();
+    other.texture = { 0 };
+    return *this;
+}
+
+TextureHandle::~TextureHandle() {
+    reset();
+}
+
+void TextureHandle::reset() {
+    if (isManaged()) AssetManager::releaseTexture(path);
+
+    path.clear();
+    texture = { 0 };
+}
+
+// Asset manager
+std::map<std::string, AssetManager::TextureEntry> AssetManager::loadedTextures;
+
+size_t AssetManager::textureBudget = 0;
+size_t AssetManager::residentBytes = 0;
+uint64_t AssetManager::useClock = 0;
+TextureStats AssetManager::counters;
+
+AssetManager::TextureEntry& AssetManager::findOrLoad(const std::string& path) {
+    auto it = loadedTextures.find(path);
+    if (it != loadedTextures.end()) {
+        counters.hits++;
+        it->second.lastUse = ++useClock;
+        it->second.orphaned = false;
+        return it->second;
+    }
+
+    counters.misses++;
+
+    TextureEntry entry;
+    entry.texture = LoadTexture((ASSETS_ROOT + path).c_str());
+    entry.bytes = getTextureSize(entry.texture);
+    entry.lastUse = ++useClock;
+
+    residentBytes += entry.bytes;
+    return loadedTextures[path] = entry;
+}
+
+void AssetManager::retainTexture(const std::string& path) {
+    auto it = loadedTextures.find(path);
+    if (it == loadedTextures.end()) return;
+
+    it->second.refCount++;
+    it->second.lastUse = ++useClock;
+}
+
+void AssetManager::releaseTexture(const std::string& path) {
+    auto it = loadedTextures.find(path);
+    if (it == loadedTextures.end()) {
+        TraceLog(LOG_WARNING, ("ASSETS: Released texture " + path + " is not loaded").c_str());
+        return;
+    }
+
+    if (it->second.refCount > 0) it->second.refCount--;
+    it->second.lastUse = ++useClock;
+
+    // Last handle of a texture that outlived unloadTextures()
+    if (it->second.refCount == 0 && it->second.orphaned) {
+        UnloadTexture(it->second.texture);
+        residentBytes -= it->second.bytes;
+        loadedTextures.erase(it);
+        return;
+    }
+
+    if (it->second.refCount == 0 && textureBudget > 0 && residentBytes > textureBudget) {
+        trimTextures();
+    }
+}
 
 Texture2D AssetManager::loadTexture(std::string path) {
-    if (loadedTextures.contains(path)) {
-        return loadedTextures[path];
+    TextureEntry& entry = findOrLoad(path);
+    entry.pinned = true;
+    return entry.texture;
+}
+
+TextureHandle AssetManager::acquireTexture(std::string path) {
+    TextureEntry& entry = findOrLoad(path);
+    entry.refCount++;
+
+    TextureHandle handle(path, entry.texture);
+
+    // The new texture is referenced, so trimming can't evict it
+    if (textureBudget > 0 && residentBytes > textureBudget) trimTextures();
+
+    return handle;
+}
+
+void AssetManager::setTextureBudget(size_t bytes) {
+    textureBudget = bytes;
+    trimTextures();
+}
+
+void AssetManager::trimTextures() {
+    if (textureBudget == 0 || residentBytes <= textureBudget) return;
+
+    std::vector<std::map<std::string, TextureEntry>::iterator> candidates;
+    for (auto it = loadedTextures.begin(); it != loadedTextures.end(); it++) {
+        if (it->second.refCount == 0 && !it->second.pinned) candidates.push_back(it);
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](auto& a, auto& b) {
+        return a->second.lastUse < b->second.lastUse;
+    });
+
+    for (auto it : candidates) {
+        if (residentBytes <= textureBudget) break;
+
+        TraceLog(LOG_INFO, ("ASSETS: Evicting texture " + it->first).c_str());
+
+        UnloadTexture(it->second.texture);
+        residentBytes -= it->second.bytes;
+        counters.evictions++;
+        loadedTextures.erase(it);
     }
 
-    Texture2D texture = LoadTexture((ASSETS_ROOT + path).c_str());
-    loadedTextures[path] = texture;
-    return texture;
+    if (residentBytes > textureBudget) {
+        TraceLog(LOG_WARNING, "ASSETS: Texture budget exceeded by referenced textures");
+    }
 }
 
-void AssetManager::unloadTextures() {
+size_t AssetManager::getTextureSize(Texture2D texture) {
+    size_t bytes = 0;
+    int width = texture.width;
+    int height = texture.height;
+
+    for (int level = 0; level < std::max(texture.mipmaps, 1); level++) {
+        bytes += GetPixelDataSize(width, height, texture.format);
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+
+    return bytes;
+}
+
+TextureStats AssetManager::getTextureStats() {
+    TextureStats stats = counters;
+    stats.budgetBytes = textureBudget;
+    stats.residentBytes = residentBytes;
+
     for (auto& texture : loadedTextures) {
-        UnloadTexture(texture.second);
+        stats.residentCount++;
+        if (texture.second.pinned) stats.pinnedCount++;
+        if (texture.second.refCount > 0) {
+            stats.referencedCount++;
+            stats.referencedBytes += texture.second.bytes;
+        }
+    }
+
+    return stats;
+}
+
+void AssetManager::unloadTextures() {
+    // Textures still held by handles stay loaded until their last handle is released
+    for (auto it = loadedTextures.begin(); it != loadedTextures.end();) {
+        if (it->second.refCount > 0) {
+            TraceLog(LOG_WARNING, ("ASSETS: Texture " + it->first + " is still referenced, unloading it on release").c_str());
+            it->second.pinned = false;
+            it->second.orphaned = true;
+            it++;
+            continue;
+        }
+
+        UnloadTexture(it->second.texture);
+        residentBytes -= it->second.bytes;
+        it = loadedTextures.erase(it);
     }
-}
\ No newline at end of file
+}
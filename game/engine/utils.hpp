@@ -2,16 +2,97 @@
 #include <raylib.h>
 #include <map>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
 #define ASSETS_ROOT (std::string)"assets/"
 
+// Reference-counted handle to a texture owned by AssetManager.
+// While at least one handle is alive the texture can't be evicted.
+class TextureHandle
+{
+public:
+    TextureHandle() {}
+    // Wraps a texture that isn't managed by AssetManager (no ref counting)
+    explicit TextureHandle(Texture2D texture) : texture(texture) {}
+
+    TextureHandle(const TextureHandle& other);
+    TextureHandle(TextureHandle&& other) noexcept;
+    TextureHandle& operator=(const TextureHandle& other);
+    TextureHandle& operator=(TextureHandle&& other) noexcept;
+    ~TextureHandle();
+
+    inline Texture2D get() const { return texture; }
+    inline const std::string& getPath() const { return path; }
+
+    inline bool isValid() const { return texture.id != 0; }
+    inline bool isManaged() const { return !path.empty(); }
+
+    void reset();
+
+private:
+    friend class AssetManager;
+    TextureHandle(std::string path, Texture2D texture) : path(path), texture(texture) {}
+
+    std::string path;
+    Texture2D texture = { 0 };
+};
+
+struct TextureStats
+{
+    int residentCount = 0;
+    int referencedCount = 0;
+    int pinnedCount = 0;
+
+    size_t residentBytes = 0;
+    size_t referencedBytes = 0;
+    size_t budgetBytes = 0;
+
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+};
+
 class AssetManager
 {
 private:
-    static std::map<std::string, Texture2D> loadedTextures;
+    struct TextureEntry
+    {
+        Texture2D texture;
+        size_t bytes = 0;
+        int refCount = 0;
+        bool pinned = false;
+        // Left behind by unloadTextures() while still referenced
+        bool orphaned = false;
+        uint64_t lastUse = 0;
+    };
+
+    static std::map<std::string, TextureEntry> loadedTextures;
+
+    static size_t textureBudget;
+    static size_t residentBytes;
+    static uint64_t useClock;
+    static TextureStats counters;
+
+    static TextureEntry& findOrLoad(const std::string& path);
+
+    friend class TextureHandle;
+    static void retainTexture(const std::string& path);
+    static void releaseTexture(const std::string& path);
 
 public:
+    // Pinned: the texture stays resident until unloadTextures()
     static Texture2D loadTexture(std::string path);
+    static TextureHandle acquireTexture(std::string path);
+
+    // 0 means unlimited. Only unreferenced, unpinned textures are evicted,
+    // least recently used first.
+    static void setTextureBudget(size_t bytes);
+    static size_t getTextureBudget() { return textureBudget; }
+    static void trimTextures();
+
+    static size_t getTextureSize(Texture2D texture);
+    static TextureStats getTextureStats();
 
     static void unloadTextures();
-};
\ No newline at end of file
+};
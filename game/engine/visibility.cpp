@@ -0,0 +1,259 @@
+#include "visibility.hpp"
+#include <algorithm>
+
+// Multipliers that map an octant-local (dx, dy) to grid offsets
+static const int octants[8][4] = {
+	{ 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+	{ -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 }
+};
+
+VisibilityField::VisibilityField(int row, int col, int radius)
+{
+	this->row = row;
+	this->col = col;
+	this->radius = radius;
+	clear();
+}
+
+bool VisibilityField::isVisible(int row, int col) const
+{
+	int localRow = row - this->row + radius;
+	int localCol = col - this->col + radius;
+	if (localRow < 0 || localCol < 0 || localRow >= getSide() || localCol >= getSide()) return false;
+
+	int bit = localRow * getSide() + localCol;
+	return (bits[bit >> 6] >> (bit & 63)) & 1;
+}
+
+void VisibilityField::setVisible(int row, int col)
+{
+	int bit = (row - this->row + radius) * getSide() + (col - this->col + radius);
+	bits[bit >> 6] |= uint64_t(1) << (bit & 63);
+}
+
+void VisibilityField::clear()
+{
+	bits.assign((getSide() * getSide() + 63) / 64, 0);
+}
+
+VisibilitySystem::VisibilitySystem(Map* map)
+{
+	this->map = map;
+	resizeMasks();
+}
+
+int VisibilitySystem::addViewer(int row, int col, int radius)
+{
+	int id;
+	if (!freeIds.empty()) {
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+	else {
+		id = fields.size();
+		fields.emplace_back();
+	}
+
+	fields[id] = VisibilityField(row, col, radius);
+	fields[id].active = true;
+	return id;
+}
+
+void VisibilitySystem::removeViewer(int id)
+{
+	VisibilityField& field = fields[id];
+	if (!field.active) return;
+
+	if (!field.dirty) applyToFog(field, -1);
+	field.active = false;
+	field.bits.clear();
+	freeIds.push_back(id);
+}
+
+void VisibilitySystem::moveViewer(int id, int row, int col)
+{
+	VisibilityField& field = fields[id];
+	if (field.row == row && field.col == col) return;
+
+	if (!field.dirty) applyToFog(field, -1);
+	field.row = row;
+	field.col = col;
+	field.dirty = true;
+}
+
+void VisibilitySystem::setViewerRadius(int id, int radius)
+{
+	VisibilityField& field = fields[id];
+	if (field.radius == radius) return;
+
+	if (!field.dirty) applyToFog(field, -1);
+	field.radius = radius;
+	field.dirty = true;
+}
+
+void VisibilitySystem::notifyTileChanged(int row, int col)
+{
+	for (VisibilityField& field : fields) {
+		if (!field.active || field.dirty) continue;
+		if (!field.covers(row, col)) continue;
+
+		applyToFog(field, -1);
+		field.dirty = true;
+	}
+}
+
+void VisibilitySystem::notifyRegionChanged(TileRect rect)
+{
+	if (rect.isEmpty()) return;
+
+	for (VisibilityField& field : fields) {
+		if (!field.active || field.dirty) continue;
+
+		// Cell of the rectangle closest to the viewer
+		int row = std::clamp(field.row, rect.row, rect.row + rect.height - 1);
+		int col = std::clamp(field.col, rect.col, rect.col + rect.width - 1);
+		if (!field.covers(row, col)) continue;
+
+		applyToFog(field, -1);
+		field.dirty = true;
+	}
+}
+
+void VisibilitySystem::invalidateAll()
+{
+	// A resize already cleared the counts and dirtied every field
+	if (width != map->getWidth() || height != map->getHeight()) {
+		resizeMasks();
+		return;
+	}
+
+	for (VisibilityField& field : fields) {
+		if (!field.active || field.dirty) continue;
+
+		applyToFog(field, -1);
+		field.dirty = true;
+	}
+}
+
+void VisibilitySystem::update()
+{
+	// After a resize (a quick load can change the map size) the masks still
+	// have the old dimensions, and a regenerated navigation map may move walls
+	bool stale = width != map->getWidth() || height != map->getHeight();
+	if (map->getNavigationMap().size() != map->getWidth() * map->getHeight()) {
+		map->generateNavigationMap();
+		stale = true;
+	}
+	if (stale) {
+		resizeMasks();
+		invalidateAll();
+	}
+
+	for (VisibilityField& field : fields) {
+		if (!field.active || !field.dirty) continue;
+
+		compute(field);
+		applyToFog(field, 1);
+	}
+}
+
+void VisibilitySystem::resizeMasks()
+{
+	if (width == map->getWidth() && height == map->getHeight()) return;
+
+	width = map->getWidth();
+	height = map->getHeight();
+
+	// Counts are rebuilt from scratch once every field is recomputed
+	visibleCounts.assign(width * height, 0);
+	fogMask.assign(width * height, 0);
+
+	for (VisibilityField& field : fields) {
+		if (field.active) field.dirty = true;
+	}
+}
+
+void VisibilitySystem::compute(VisibilityField& field)
+{
+	field.clear();
+	field.dirty = false;
+
+	if (field.row >= 0 && field.col >= 0 && field.row < height && field.col < width) {
+		field.setVisible(field.row, field.col);
+	}
+
+	for (int i = 0; i < 8; i++) {
+		castLight(field, 1, 1.0f, 0.0f, octants[i][0], octants[i][1], octants[i][2], octants[i][3]);
+	}
+}
+
+void VisibilitySystem::castLight(VisibilityField& field, int startColumn, float startSlope, float endSlope,
+	int xx, int xy, int yx, int yy)
+{
+	if (startSlope < endSlope) return;
+
+	int radius = field.radius;
+	int radiusSquared = radius * radius;
+	float nextStartSlope = startSlope;
+
+	for (int distance = startColumn; distance <= radius; distance++) {
+		bool blocked = false;
+		int dy = -distance;
+
+		for (int dx = -distance; dx <= 0; dx++) {
+			float leftSlope = (dx - 0.5f) / (dy + 0.5f);
+			float rightSlope = (dx + 0.5f) / (dy - 0.5f);
+
+			if (startSlope < rightSlope) continue;
+			if (endSlope > leftSlope) break;
+
+			int col = field.col + dx * xx + dy * xy;
+			int row = field.row + dx * yx + dy * yy;
+
+			bool inBounds = row >= 0 && col >= 0 && row < height && col < width;
+			if (inBounds && dx * dx + dy * dy <= radiusSquared) {
+				field.setVisible(row, col);
+			}
+
+			bool opaque = isOpaque(row, col);
+			if (blocked) {
+				if (opaque) {
+					nextStartSlope = rightSlope;
+					continue;
+				}
+
+				blocked = false;
+				startSlope = nextStartSlope;
+			}
+			else if (opaque && distance < radius) {
+				blocked = true;
+				castLight(field, distance + 1, startSlope, leftSlope, xx, xy, yx, yy);
+				nextStartSlope = rightSlope;
+			}
+		}
+
+		if (blocked) break;
+	}
+}
+
+void VisibilitySystem::applyToFog(const VisibilityField& field, int delta)
+{
+	int side = field.getSide();
+	int startRow = std::max(field.row - field.radius, 0);
+	int endRow = std::min(field.row + field.radius, height - 1);
+	int startCol = std::max(field.col - field.radius, 0);
+	int endCol = std::min(field.col + field.radius, width - 1);
+
+	for (int i = startRow; i <= endRow; i++) {
+		int rowBit = (i - field.row + field.radius) * side - field.col + field.radius;
+
+		for (int j = startCol; j <= endCol; j++) {
+			int bit = rowBit + j;
+			if (!((field.bits[bit >> 6] >> (bit & 63)) & 1)) continue;
+
+			uint16_t& count = visibleCounts[i * width + j];
+			count += delta;
+			fogMask[i * width + j] = count > 0;
+		}
+	}
+}
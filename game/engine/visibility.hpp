@@ -0,0 +1,97 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "world.hpp"
+
+// Cells seen by a single viewer (a tower), stored as a bitset over the
+// square of side 2 * radius + 1 centered on the viewer
+class VisibilityField
+{
+public:
+	VisibilityField() {}
+	VisibilityField(int row, int col, int radius);
+
+	inline int getRow() const { return row; }
+	inline int getCol() const { return col; }
+	inline int getRadius() const { return radius; }
+	inline int getSide() const { return radius * 2 + 1; }
+
+	inline bool isDirty() const { return dirty; }
+	inline void markDirty() { dirty = true; }
+
+	inline bool covers(int row, int col) const {
+		int dr = row - this->row;
+		int dc = col - this->col;
+		return dr * dr + dc * dc <= radius * radius;
+	}
+
+	bool isVisible(int row, int col) const;
+	void setVisible(int row, int col);
+	void clear();
+
+	inline const std::vector<uint64_t>& getBits() const { return bits; }
+
+private:
+	friend class VisibilitySystem;
+
+	int row = 0;
+	int col = 0;
+	int radius = 0;
+	bool dirty = true;
+	bool active = false;
+
+	std::vector<uint64_t> bits;
+};
+
+// Recursive shadowcasting over the navigation grid of a Map.
+// Fields are only recomputed when a solid cell inside their radius changes.
+class VisibilitySystem
+{
+public:
+	VisibilitySystem(Map* map);
+
+	inline Map* getMap() { return map; }
+
+	int addViewer(int row, int col, int radius);
+	void removeViewer(int id);
+	void moveViewer(int id, int row, int col);
+	void setViewerRadius(int id, int radius);
+
+	inline VisibilityField& getField(int id) { return fields[id]; }
+	inline bool isVisible(int id, int row, int col) const { return fields[id].isVisible(row, col); }
+
+	// Call after the navigation map cell at (row, col) changed
+	void notifyTileChanged(int row, int col);
+	// Same for every cell of a rectangle
+	void notifyRegionChanged(TileRect rect);
+	// Call after Map::generateNavigationMap or a map resize
+	void invalidateAll();
+
+	void update();
+
+	// One byte per map cell, non-zero when any viewer sees the cell
+	inline const std::vector<uint8_t>& getFogMask() const { return fogMask; }
+	inline bool isRevealed(int row, int col) const { return fogMask[row * width + col] != 0; }
+
+private:
+	Map* map;
+	int width = 0;
+	int height = 0;
+
+	std::vector<VisibilityField> fields;
+	std::vector<int> freeIds;
+
+	std::vector<uint16_t> visibleCounts;
+	std::vector<uint8_t> fogMask;
+
+	void resizeMasks();
+	void compute(VisibilityField& field);
+	void castLight(VisibilityField& field, int startColumn, float startSlope, float endSlope,
+		int xx, int xy, int yx, int yy);
+	void applyToFog(const VisibilityField& field, int delta);
+
+	inline bool isOpaque(int row, int col) {
+		if (row < 0 || col < 0 || row >= height || col >= width) return true;
+		return map->getNavigationMap()[row * width + col] == 1;
+	}
+};
@@ -1,4 +1,5 @@
 #include "world.hpp"
+#include <algorithm>
 
 Sprite::Sprite(AnimationPlayer* animPlayer, Vector2 position)
 	: Sprite(animPlayer, position, { 1, 1 })
@@ -19,9 +20,9 @@ Sprite::Sprite(AnimationPlayer* animPlayer, Vector2 position, Vector2 scale, Vec
 	this->centered = centered;
 }
 
-void Sprite::update()
+void Sprite::update(float delta)
 {
-	animPlayer->update();
+	animPlayer->update(delta);
 }
 
 void Sprite::draw()
@@ -38,3 +39,36 @@ void Sprite::draw()
 
 	if (shader) EndShaderMode();
 }
+
+void Map::update()
+{
+	update(GetFrameTime());
+}
+
+void Map::update(float delta)
+{
+	// Layers may share a tileset, animate each one only once
+	std::vector<Tileset*> updatedTilesets;
+	for (std::shared_ptr<TilemapLayer> layer : mapLayers) {
+		Tileset* tileset = layer.get()->getTileset();
+		if (std::find(updatedTilesets.begin(), updatedTilesets.end(), tileset) != updatedTilesets.end()) continue;
+
+		tileset->update(delta);
+		updatedTilesets.push_back(tileset);
+	}
+
+	for (std::shared_ptr<Sprite> sprite : sprites) {
+		sprite.get()->update(delta);
+	}
+}
+
+void Map::draw(const Camera2D& camera, int viewportWidth, int viewportHeight)
+{
+	for (std::shared_ptr<TilemapLayer> layer : mapLayers) {
+		layer.get()->draw(camera, viewportWidth, viewportHeight);
+	}
+
+	for (std::shared_ptr<Sprite> sprite : sprites) {
+		sprite.get()->draw();
+	}
+}
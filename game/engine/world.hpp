@@ -4,6 +4,7 @@
 #include <unordered_map>
 #include <typeindex>
 #include <memory>
+#include <algorithm>
 #include "sequence.hpp"
 #include "gfx.hpp"
 
@@ -28,12 +29,31 @@ public:
 	inline Vector2 getOrigin() const { return origin; }
 	inline void setOrigin(Vector2 origin) { this->origin = origin; }
 
+	inline bool isCentered() const { return centered; }
+	inline void setCentered(bool centered) { this->centered = centered; }
+
 	inline bool getFlipX() const { return flipX; }
 	inline void setFlipX(bool flipX) { this->flipX = flipX; }
 
 	inline bool getFlipY() const { return flipY; }
 	inline void setFlipY(bool flipY) { this->flipY = flipY; }
 
+	// Owner pool and slot of pooled sprites, -1 for the others. Deserialized
+	// snapshots use them to find the sprite again.
+	inline int getPool() const { return pool; }
+	inline int getPoolSlot() const { return poolSlot; }
+	inline void setPoolSlot(int pool, int poolSlot) {
+		this->pool = pool;
+		this->poolSlot = poolSlot;
+	}
+
+	inline SoundId getSound() const { return soundId; }
+	inline void setSound(SoundId soundId) { this->soundId = soundId; }
+	// Plays the sprite's sound at its position, nothing when it has none
+	inline void playSound(SoundMixer* mixer) {
+		if (mixer && soundId != INVALID_SOUND) mixer->play(soundId, position);
+	}
+
 	inline Shader* getShader() { return shader.get(); }
 	inline void setShader(const Shader& shader) { this->shader = std::make_unique<Shader>(shader); }
 	inline void unsetShader() {
@@ -51,7 +71,8 @@ public:
 		SetShaderValue(*shader.get(), shaderParameterLocations[name], value, valueType);
 	}
 
-	virtual void update();
+	inline void update() { update(GetFrameTime()); }
+	virtual void update(float delta);
 	virtual void draw();
 
 protected:
@@ -64,6 +85,11 @@ protected:
 	bool flipX = false;
 	bool flipY = false;
 
+	int pool = -1;
+	int poolSlot = -1;
+
+	SoundId soundId = INVALID_SOUND;
+
 	std::unique_ptr<Shader> shader;
 	std::unordered_map<std::string, int> shaderParameterLocations;
 };
@@ -105,6 +131,12 @@ public:
 		}
 	}
 
+	inline std::vector<std::shared_ptr<Sprite>>& getSprites() { return sprites; }
+	inline void addSprite(std::shared_ptr<Sprite> sprite) { sprites.push_back(sprite); }
+	inline void removeSprite(Sprite* sprite) {
+		std::erase_if(sprites, [sprite](std::shared_ptr<Sprite>& item) { return item.get() == sprite; });
+	}
+
 	inline std::vector<std::shared_ptr<TilemapLayer>>& getMapLayers() { return mapLayers; }
 	inline TilemapLayer* getMapLayer(int index) { return mapLayers[index].get(); }
 	inline void addMapLayer(std::string name, Tileset* tileset) {
@@ -127,7 +159,7 @@ public:
 	// 				int id = layer->getTile(i, j);
 	// 				if (id == 0) continue;
 
-	// 				bool isSolid = layer->getTileset()->getTileById(id)->solid;
+	// 				bool isSolid = layer->getTileset()->isTileSolid(id);
 	// 				if (isSolid) {
 	// 					Collider collider(cellSize * j, cellSize * i, cellSize, cellSize);
 	// 					colliders.push_back(collider);
@@ -138,28 +170,74 @@ public:
 	// }
 
 	inline std::vector<int>& getNavigationMap() { return navigationMap; }
+	// Bumped by every navigation rebuild, direct writes must call touchNavigationMap
+	inline uint32_t getNavigationVersion() const { return navigationVersion; }
+	inline void touchNavigationMap() { navigationVersion++; }
 	void generateNavigationMap() {
-		navigationMap.clear();
-		for (int i = 0; i < height * width; i++) {
-			navigationMap.push_back(0);
+		navigationVersion++;
+		navigationMap.assign(height * width, 0);
+
+		for (std::shared_ptr<TilemapLayer> layer : mapLayers) {
+			const int* layout = layer.get()->getLayout();
+			const uint8_t* flags = layer.get()->getTileset()->getTileFlags();
+
+			for (int i = 0; i < height * width; i++) {
+				if (layout[i] > 0 && (flags[layout[i]] & TILE_SOLID)) navigationMap[i] = 1;
+			}
+		}
+	}
+
+	// Re-evaluates a single cell after one of its tiles changed
+	inline void updateNavigationCell(int row, int col) {
+		if (navigationMap.size() != height * width) {
+			generateNavigationMap();
+			return;
 		}
 
+		int solid = 0;
 		for (std::shared_ptr<TilemapLayer> layer : mapLayers) {
-			for (int i = 0; i < height; i++) {
-				for (int j = 0; j < width; j++) {
-					if (navigationMap[i * width + j] == 1) continue;
+			int id = layer.get()->getTile(row, col);
+			if (id <= 0) continue;
 
-					int id = layer.get()->getTile(i, j);
-					if (id == 0) continue;
+			if (layer.get()->getTileset()->isTileSolid(id)) {
+				solid = 1;
+				break;
+			}
+		}
+		if (navigationMap[row * width + col] != solid) navigationVersion++;
+		navigationMap[row * width + col] = solid;
+	}
 
-					Tile* tile = layer.get()->getTileset()->getTileById(id);
-					if (tile->solid) navigationMap[i * width + j] = 1;
+	// Re-evaluates every cell of a rectangle after a bulk edit, bumping the version once
+	inline void updateNavigationRect(TileRect rect) {
+		if (navigationMap.size() != height * width) {
+			generateNavigationMap();
+			return;
+		}
+
+		std::vector<int> row(rect.width);
+		bool changed = false;
+		for (int i = rect.row; i < rect.row + rect.height; i++) {
+			std::fill(row.begin(), row.end(), 0);
+
+			for (std::shared_ptr<TilemapLayer>& layer : mapLayers) {
+				const int* layout = layer.get()->getLayout() + i * width + rect.col;
+				const uint8_t* flags = layer.get()->getTileset()->getTileFlags();
+
+				for (int j = 0; j < rect.width; j++) {
+					if (layout[j] > 0 && (flags[layout[j]] & TILE_SOLID)) row[j] = 1;
 				}
 			}
+
+			int* navigation = &navigationMap[i * width + rect.col];
+			changed |= !std::equal(row.begin(), row.end(), navigation);
+			std::copy(row.begin(), row.end(), navigation);
 		}
+		if (changed) navigationVersion++;
 	}
 
 	void update();
+	void update(float delta);
 	void draw(const Camera2D& camera, int viewportWidth, int viewportHeight);
 
 private:
@@ -178,5 +256,6 @@ private:
 	Tileset* currentTileset = nullptr;
 
 	std::vector<int> navigationMap;
+	uint32_t navigationVersion = 0;
 
 };